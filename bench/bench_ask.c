@@ -0,0 +1,88 @@
+#include "cacti.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define MSG_ECHO 1
+
+static size_t asks = 100000;
+static size_t workers = 0;
+
+static void echo_hello(void **stateptr, size_t nbytes, void *data);
+static void echo(void **stateptr, size_t nbytes, void *data);
+
+static act_t echo_acts[2] = {echo_hello, echo};
+static role_t echo_role = {2, echo_acts};
+
+static void echo_hello(void **stateptr, size_t nbytes, void *data) {
+	(void)stateptr; (void)nbytes; (void)data;
+}
+
+static void echo(void **stateptr, size_t nbytes, void *data) {
+	(void)stateptr;
+
+	actor_reply(actor_reply_handle(), (message_t){0, nbytes, data});
+}
+
+static long nsec_since(struct timespec *start) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (now.tv_sec - start->tv_sec) * 1000000000L + (now.tv_nsec - start->tv_nsec);
+}
+
+static int compare_long(const void *a, const void *b) {
+	long x = *(const long *)a;
+	long y = *(const long *)b;
+
+	return (x > y) - (x < y);
+}
+
+int main(int argc, char **argv) {
+	if (argc > 1) {
+		asks = strtoul(argv[1], NULL, 10);
+	}
+	if (argc > 2) {
+		workers = strtoul(argv[2], NULL, 10);
+	}
+
+	actor_system_config_t config = {0};
+	config.pool_size = workers;
+
+	actor_id_t actor;
+	if (actor_system_create_ex(&actor, &echo_role, &config) != 0) {
+		return 1;
+	}
+
+	long *latency = calloc(asks, sizeof(long));
+	if (latency == NULL) {
+		return 1;
+	}
+
+	size_t failed = 0;
+	for (size_t i = 0; i < asks; i++) {
+		struct timespec start;
+		clock_gettime(CLOCK_MONOTONIC, &start);
+
+		actor_future_t *future = actor_ask(actor, (message_t){MSG_ECHO, 0, (void *)i}, -1);
+		message_t reply;
+		if (future == NULL || actor_future_wait(future, &reply) != 0 || (size_t)reply.data != i) {
+			failed++;
+		}
+		actor_future_free(future);
+
+		latency[i] = nsec_since(&start);
+	}
+
+	send_message(actor, (message_t){MSG_GODIE, 0, NULL});
+	actor_system_join(actor);
+
+	qsort(latency, asks, sizeof(long), compare_long);
+	printf("ask workers=%zu asks=%zu failed=%zu p50_us=%.1f p99_us=%.1f max_us=%.1f\n",
+		workers, asks, failed, latency[asks / 2] / 1e3, latency[asks * 99 / 100] / 1e3, latency[asks - 1] / 1e3);
+
+	free(latency);
+
+	return failed != 0;
+}
@@ -0,0 +1,88 @@
+#include "cacti.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define MSG_COUNT 1
+
+static size_t senders = 1000;
+static size_t messages = 1000;
+static size_t workers = 0;
+static const char *trace_path = NULL;
+static size_t received = 0;
+static struct timespec start;
+static struct timespec end;
+
+static void aggregator_hello(void **stateptr, size_t nbytes, void *data);
+static void aggregator_count(void **stateptr, size_t nbytes, void *data);
+static void sender_hello(void **stateptr, size_t nbytes, void *data);
+
+static act_t aggregator_acts[2] = {aggregator_hello, aggregator_count};
+static role_t aggregator_role = {2, aggregator_acts};
+
+static act_t sender_acts[1] = {sender_hello};
+static role_t sender_role = {1, sender_acts};
+
+static void aggregator_hello(void **stateptr, size_t nbytes, void *data) {
+	(void)stateptr; (void)nbytes; (void)data;
+
+	actor_mailbox_configure(actor_id_self(), MAILBOX_GROW, 0);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	for (size_t i = 0; i < senders; i++) {
+		send_message(actor_id_self(), (message_t){MSG_SPAWN, 0, &sender_role});
+	}
+}
+
+static void aggregator_count(void **stateptr, size_t nbytes, void *data) {
+	(void)stateptr; (void)nbytes; (void)data;
+
+	if (++received == senders * messages) {
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		send_message(actor_id_self(), (message_t){MSG_GODIE, 0, NULL});
+	}
+}
+
+static void sender_hello(void **stateptr, size_t nbytes, void *data) {
+	(void)stateptr; (void)nbytes;
+
+	actor_id_t aggregator = (actor_id_t)data;
+	for (size_t i = 0; i < messages; i++) {
+		send_message(aggregator, (message_t){MSG_COUNT, 0, NULL});
+	}
+
+	send_message(actor_id_self(), (message_t){MSG_GODIE, 0, NULL});
+}
+
+int main(int argc, char **argv) {
+	if (argc > 1) {
+		senders = strtoul(argv[1], NULL, 10);
+	}
+	if (argc > 2) {
+		messages = strtoul(argv[2], NULL, 10);
+	}
+	if (argc > 3) {
+		workers = strtoul(argv[3], NULL, 10);
+	}
+	if (argc > 4) {
+		trace_path = argv[4];
+	}
+
+	actor_system_config_t config = {0};
+	config.pool_size = workers;
+	config.trace_path = trace_path;
+
+	actor_id_t aggregator;
+	if (actor_system_create_ex(&aggregator, &aggregator_role, &config) != 0) {
+		return 1;
+	}
+	actor_system_join(aggregator);
+
+	double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+	printf("fanin workers=%zu traced=%d senders=%zu messages=%zu received=%zu seconds=%.3f msgs_per_sec=%.0f\n",
+		workers, trace_path != NULL, senders, messages, received, seconds, received / seconds);
+
+	return received != senders * messages;
+}
@@ -0,0 +1,110 @@
+#include "cacti.h"
+
+#include <malloc.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define MSG_PAYLOAD 1
+#define PAYLOAD 24
+
+static size_t senders = 100;
+static size_t messages = 10000;
+static size_t workers = 0;
+static bool use_inline;
+static size_t received = 0;
+static size_t checksum = 0;
+static struct timespec start;
+static struct timespec end;
+
+static void aggregator_hello(void **stateptr, size_t nbytes, void *data);
+static void aggregator_payload(void **stateptr, size_t nbytes, void *data);
+static void sender_hello(void **stateptr, size_t nbytes, void *data);
+
+static act_t aggregator_acts[2] = {aggregator_hello, aggregator_payload};
+static role_t aggregator_role = {2, aggregator_acts};
+
+static act_t sender_acts[1] = {sender_hello};
+static role_t sender_role = {1, sender_acts};
+
+static void aggregator_hello(void **stateptr, size_t nbytes, void *data) {
+	(void)stateptr; (void)nbytes; (void)data;
+
+	actor_mailbox_configure(actor_id_self(), MAILBOX_GROW, 0);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	for (size_t i = 0; i < senders; i++) {
+		send_message(actor_id_self(), (message_t){MSG_SPAWN, 0, &sender_role});
+	}
+}
+
+static void aggregator_payload(void **stateptr, size_t nbytes, void *data) {
+	(void)stateptr; (void)nbytes;
+
+	checksum += ((unsigned char *)data)[0];
+	if (!use_inline) {
+		free(data);
+	}
+
+	if (++received == senders * messages) {
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		send_message(actor_id_self(), (message_t){MSG_GODIE, 0, NULL});
+	}
+}
+
+static void sender_hello(void **stateptr, size_t nbytes, void *data) {
+	(void)stateptr; (void)nbytes;
+
+	actor_id_t aggregator = (actor_id_t)data;
+	unsigned char payload[PAYLOAD];
+	memset(payload, 1, sizeof(payload));
+
+	for (size_t i = 0; i < messages; i++) {
+		if (use_inline) {
+			send_message_inline(aggregator, MSG_PAYLOAD, payload, sizeof(payload));
+		} else {
+			void *copy = malloc(sizeof(payload));
+			memcpy(copy, payload, sizeof(payload));
+			send_message(aggregator, (message_t){MSG_PAYLOAD, sizeof(payload), copy});
+		}
+	}
+
+	send_message(actor_id_self(), (message_t){MSG_GODIE, 0, NULL});
+}
+
+int main(int argc, char **argv) {
+	if (argc > 1) {
+		use_inline = strcmp(argv[1], "inline") == 0;
+	}
+	if (argc > 2) {
+		senders = strtoul(argv[2], NULL, 10);
+	}
+	if (argc > 3) {
+		messages = strtoul(argv[3], NULL, 10);
+	}
+	if (argc > 4) {
+		workers = strtoul(argv[4], NULL, 10);
+	}
+
+	actor_system_config_t config = {0};
+	config.pool_size = workers;
+
+	actor_id_t aggregator;
+	if (actor_system_create_ex(&aggregator, &aggregator_role, &config) != 0) {
+		return 1;
+	}
+	actor_system_join(aggregator);
+
+	// Every payload malloc'd by a sender is one allocation and one free on
+	// another thread, inline payloads cost neither.
+	struct mallinfo2 info = mallinfo2();
+	double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+	printf("inline mode=%s workers=%zu messages=%zu payload_allocs=%zu seconds=%.3f msgs_per_sec=%.0f arena_kb=%zu\n",
+		use_inline ? "inline" : "malloc", workers, received, use_inline ? 0 : received,
+		seconds, received / seconds, info.arena / 1024);
+
+	return received != senders * messages || checksum != received;
+}
@@ -0,0 +1,67 @@
+#include "cacti.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+#include <time.h>
+
+static size_t actors = 1000000;
+static size_t fanout = 8;
+static size_t workers = 0;
+static struct timespec start;
+static struct timespec end;
+
+static void node_hello(void **stateptr, size_t nbytes, void *data);
+
+static act_t node_acts[1] = {node_hello};
+static role_t node_role = {1, node_acts};
+
+// Every actor spawns the children of its position in a complete fanout-ary
+// tree, so the tree holds exactly `actors` actors and dies right away.
+static void node_hello(void **stateptr, size_t nbytes, void *data) {
+	(void)stateptr; (void)nbytes; (void)data;
+
+	actor_id_t self = actor_id_self();
+	for (size_t i = 1; i <= fanout; i++) {
+		if ((size_t)self * fanout + i < actors) {
+			send_message(self, (message_t){MSG_SPAWN, 0, &node_role});
+		}
+	}
+
+	send_message(self, (message_t){MSG_GODIE, 0, NULL});
+}
+
+int main(int argc, char **argv) {
+	if (argc > 1) {
+		actors = strtoul(argv[1], NULL, 10);
+	}
+	if (argc > 2) {
+		fanout = strtoul(argv[2], NULL, 10);
+	}
+	if (argc > 3) {
+		workers = strtoul(argv[3], NULL, 10);
+	}
+
+	actor_system_config_t config = {0};
+	config.pool_size = workers;
+	config.cast_limit = actors;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	actor_id_t root;
+	if (actor_system_create_ex(&root, &node_role, &config) != 0) {
+		return 1;
+	}
+	actor_system_join(root);
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+
+	double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+	printf("spawn workers=%zu actors=%zu fanout=%zu seconds=%.3f spawns_per_sec=%.0f max_rss_kb=%ld\n",
+		workers, actors, fanout, seconds, actors / seconds, usage.ru_maxrss);
+
+	return 0;
+}
@@ -0,0 +1,91 @@
+#include "cacti.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define MSG_FIRE 1
+
+static size_t timers = 1000000;
+static long spread_usec = 100000;
+static size_t fired = 0;
+static double insert_ns;
+static double cancel_ns;
+static struct timespec armed;
+static struct timespec done;
+
+static void hello(void **stateptr, size_t nbytes, void *data);
+static void fire(void **stateptr, size_t nbytes, void *data);
+
+static act_t acts[2] = {hello, fire};
+static role_t role = {2, acts};
+
+static double nsec_since(struct timespec *start) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (now.tv_sec - start->tv_sec) * 1e9 + (now.tv_nsec - start->tv_nsec);
+}
+
+// Arms and cancels every timer once to time both, then arms them for real.
+static void hello(void **stateptr, size_t nbytes, void *data) {
+	(void)stateptr; (void)nbytes; (void)data;
+
+	actor_id_t self = actor_id_self();
+	actor_mailbox_configure(self, MAILBOX_GROW, 0);
+
+	actor_timer_t *ids = calloc(timers, sizeof(actor_timer_t));
+	if (ids == NULL) {
+		exit(1);
+	}
+
+	struct timespec start;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (size_t i = 0; i < timers; i++) {
+		ids[i] = send_message_after(self, (message_t){MSG_FIRE, 0, NULL}, 1000000 + rand() % 10000000);
+	}
+	insert_ns = nsec_since(&start) / timers;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (size_t i = 0; i < timers; i++) {
+		actor_timer_cancel(ids[i]);
+	}
+	cancel_ns = nsec_since(&start) / timers;
+
+	free(ids);
+
+	clock_gettime(CLOCK_MONOTONIC, &armed);
+	for (size_t i = 0; i < timers; i++) {
+		send_message_after(self, (message_t){MSG_FIRE, 0, NULL}, rand() % spread_usec);
+	}
+}
+
+static void fire(void **stateptr, size_t nbytes, void *data) {
+	(void)stateptr; (void)nbytes; (void)data;
+
+	if (++fired == timers) {
+		clock_gettime(CLOCK_MONOTONIC, &done);
+		send_message(actor_id_self(), (message_t){MSG_GODIE, 0, NULL});
+	}
+}
+
+int main(int argc, char **argv) {
+	if (argc > 1) {
+		timers = strtoul(argv[1], NULL, 10);
+	}
+	if (argc > 2) {
+		spread_usec = strtol(argv[2], NULL, 10);
+	}
+
+	actor_id_t actor;
+	if (actor_system_create(&actor, &role) != 0) {
+		return 1;
+	}
+	actor_system_join(actor);
+
+	double seconds = (done.tv_sec - armed.tv_sec) + (done.tv_nsec - armed.tv_nsec) / 1e9;
+	printf("timers timers=%zu spread_usec=%ld insert_ns=%.0f cancel_ns=%.0f fired=%zu last_fired_after=%.3f\n",
+		timers, spread_usec, insert_ns, cancel_ns, fired, seconds);
+
+	return fired != timers;
+}
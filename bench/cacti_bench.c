@@ -0,0 +1,436 @@
+#include "cacti.h"
+
+#include <math.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MSG_JOIN 1
+#define MSG_DONE 2
+#define MSG_PING 3
+#define MSG_WORK 4
+#define MSG_GO 5
+
+#define LATENCY_SAMPLES 65536
+#define SPAWN_FANOUT 8
+#define ZIPF_SKEW 0.99
+#define ZIPF_SENDERS 8
+
+// Every scenario runs in a child process of its own, so max_rss_kb is the
+// peak of that run alone, and prints one line of key=value pairs. Message
+// counts are scaled by the third argument.
+typedef struct scenario
+{
+	const char *name;
+	size_t actors;
+	size_t messages;
+	void (*go)();
+} scenario_t;
+
+typedef struct stamp
+{
+	uint64_t sent_nsec;
+	actor_id_t from;
+} stamp_t;
+
+static struct
+{
+	const scenario_t *scenario;
+	size_t actors;
+	size_t messages;
+	size_t total;
+	size_t stride;
+	actor_id_t root;
+	actor_id_t *peers;
+	size_t joined;
+	atomic_size_t received;
+	atomic_size_t failed;
+	uint64_t start_nsec;
+	uint64_t end_nsec;
+	uint64_t *spawned_nsec;
+	double *zipf_cdf;
+	uint64_t latency[LATENCY_SAMPLES];
+	atomic_size_t samples;
+} run;
+
+static uint64_t now_nsec() {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+static void record_latency(uint64_t sent_nsec) {
+	if (sent_nsec == 0) {
+		return;
+	}
+
+	size_t i = atomic_fetch_add_explicit(&run.samples, 1, memory_order_relaxed);
+	if (i < LATENCY_SAMPLES) {
+		run.latency[i] = now_nsec() - sent_nsec;
+	}
+}
+
+// Only every stride-th message carries a send time, so the clock reads and
+// the samples stay bounded whatever the message count.
+static void send_stamped(actor_id_t actor, message_type_t type, size_t sequence) {
+	stamp_t stamp = {sequence % run.stride == 0 ? now_nsec() : 0, actor_id_self()};
+
+	if (send_message_inline(actor, type, &stamp, sizeof(stamp)) != 0) {
+		atomic_fetch_add(&run.failed, 1);
+	}
+}
+
+static void finish() {
+	run.end_nsec = now_nsec();
+	send_message(run.root, (message_t){MSG_DONE, 0, NULL});
+}
+
+static void count_message() {
+	if (atomic_fetch_add(&run.received, 1) + 1 == run.total) {
+		finish();
+	}
+}
+
+static void root_hello(void **stateptr, size_t nbytes, void *data);
+static void root_join(void **stateptr, size_t nbytes, void *data);
+static void root_done(void **stateptr, size_t nbytes, void *data);
+static void peer_hello(void **stateptr, size_t nbytes, void *data);
+static void peer_go(void **stateptr, size_t nbytes, void *data);
+static void ping(void **stateptr, size_t nbytes, void *data);
+static void work(void **stateptr, size_t nbytes, void *data);
+static void ignore(void **stateptr, size_t nbytes, void *data);
+
+static act_t root_acts[6] = {root_hello, root_join, root_done, ping, work, ignore};
+static role_t root_role = {6, root_acts};
+
+static act_t peer_acts[6] = {peer_hello, ignore, ignore, ping, work, peer_go};
+static role_t peer_role = {6, peer_acts};
+
+// Actor ids are plain indexes here, so each actor spawns the children of its
+// position in a complete tree of run.actors actors.
+static void spawn_children(actor_id_t self) {
+	run.spawned_nsec[self] = now_nsec();
+
+	for (size_t i = 1; i <= SPAWN_FANOUT; i++) {
+		if ((size_t)self * SPAWN_FANOUT + i < run.actors) {
+			send_message(self, (message_t){MSG_SPAWN, 0, &peer_role});
+		}
+	}
+}
+
+static void root_hello(void **stateptr, size_t nbytes, void *data) {
+	(void)stateptr; (void)nbytes; (void)data;
+
+	actor_id_t self = actor_id_self();
+	actor_mailbox_configure(self, MAILBOX_GROW, 0);
+
+	if (run.spawned_nsec != NULL) {
+		run.start_nsec = now_nsec();
+		spawn_children(self);
+		return;
+	}
+
+	for (size_t i = 0; i < run.actors; i++) {
+		send_message(self, (message_t){MSG_SPAWN, 0, &peer_role});
+	}
+}
+
+static void root_join(void **stateptr, size_t nbytes, void *data) {
+	(void)stateptr; (void)nbytes;
+
+	run.peers[run.joined++] = ((stamp_t *)data)->from;
+	if (run.joined == run.actors) {
+		run.start_nsec = now_nsec();
+		run.scenario->go();
+	}
+}
+
+static void root_done(void **stateptr, size_t nbytes, void *data) {
+	(void)stateptr; (void)nbytes; (void)data;
+
+	for (size_t i = 0; i < run.joined; i++) {
+		send_message(run.peers[i], (message_t){MSG_GODIE, 0, NULL});
+	}
+	send_message(actor_id_self(), (message_t){MSG_GODIE, 0, NULL});
+}
+
+static void peer_hello(void **stateptr, size_t nbytes, void *data) {
+	(void)stateptr; (void)nbytes;
+
+	actor_id_t self = actor_id_self();
+	if (run.spawned_nsec != NULL) {
+		actor_id_t parent = (actor_id_t)data;
+		if ((size_t)self % run.stride == 0) {
+			record_latency(run.spawned_nsec[parent]);
+		}
+		spawn_children(self);
+		send_message(self, (message_t){MSG_GODIE, 0, NULL});
+		count_message();
+		return;
+	}
+
+	actor_mailbox_configure(self, MAILBOX_GROW, 0);
+	send_stamped(run.root, MSG_JOIN, 1);
+}
+
+static void ping(void **stateptr, size_t nbytes, void *data) {
+	(void)stateptr; (void)nbytes;
+
+	stamp_t *stamp = data;
+	record_latency(stamp->sent_nsec);
+
+	size_t received = atomic_fetch_add(&run.received, 1) + 1;
+	if (received == run.total) {
+		finish();
+	} else {
+		send_stamped(stamp->from, MSG_PING, received);
+	}
+}
+
+static void work(void **stateptr, size_t nbytes, void *data) {
+	(void)stateptr; (void)nbytes;
+
+	record_latency(((stamp_t *)data)->sent_nsec);
+	count_message();
+}
+
+static void ignore(void **stateptr, size_t nbytes, void *data) {
+	(void)stateptr; (void)nbytes; (void)data;
+}
+
+// Inverse transform sampling over the cumulative Zipf weights of the targets,
+// rank 0 being the hottest.
+static size_t zipf_target(uint64_t *seed) {
+	*seed ^= *seed << 13;
+	*seed ^= *seed >> 7;
+	*seed ^= *seed << 17;
+	double u = (*seed >> 11) * (1.0 / 9007199254740992.0);
+
+	size_t low = 0;
+	size_t high = run.actors - ZIPF_SENDERS - 1;
+	while (low < high) {
+		size_t middle = (low + high) / 2;
+		if (run.zipf_cdf[middle] < u) {
+			low = middle + 1;
+		} else {
+			high = middle;
+		}
+	}
+
+	return low;
+}
+
+static void peer_go(void **stateptr, size_t nbytes, void *data) {
+	(void)stateptr; (void)nbytes; (void)data;
+
+	if (run.zipf_cdf == NULL) {
+		for (size_t i = 0; i < run.messages; i++) {
+			send_stamped(run.root, MSG_WORK, i);
+		}
+		return;
+	}
+
+	uint64_t seed = 0x9e3779b97f4a7c15ULL * (actor_id_self() + 1);
+	for (size_t i = 0; i < run.messages; i++) {
+		send_stamped(run.peers[zipf_target(&seed)], MSG_WORK, i);
+	}
+}
+
+static void pingpong_go() {
+	send_stamped(run.peers[0], MSG_PING, 0);
+}
+
+static void fanin_go() {
+	for (size_t i = 0; i < run.actors; i++) {
+		send_message(run.peers[i], (message_t){MSG_GO, 0, NULL});
+	}
+}
+
+static void fanout_go() {
+	for (size_t round = 0; round < run.messages; round++) {
+		for (size_t i = 0; i < run.actors; i++) {
+			send_stamped(run.peers[i], MSG_WORK, round * run.actors + i);
+		}
+	}
+}
+
+// The first joined peers are the targets, the last ZIPF_SENDERS send.
+static void zipf_go() {
+	for (size_t i = run.actors - ZIPF_SENDERS; i < run.actors; i++) {
+		send_message(run.peers[i], (message_t){MSG_GO, 0, NULL});
+	}
+}
+
+static const scenario_t scenarios[] = {
+	{"pingpong", 1, 100000, pingpong_go},
+	{"fanin", 1000, 1000, fanin_go},
+	{"fanout", 1000, 1000, fanout_go},
+	{"spawn", 1000000, 0, NULL},
+	{"zipf", 1000 + ZIPF_SENDERS, 125000, zipf_go},
+};
+
+static int prepare(const scenario_t *scenario, double scale) {
+	run.scenario = scenario;
+	run.actors = scenario->actors;
+	run.messages = scenario->messages * scale;
+
+	if (strcmp(scenario->name, "pingpong") == 0) {
+		run.total = run.messages;
+	} else if (strcmp(scenario->name, "spawn") == 0) {
+		run.actors = scenario->actors * scale;
+		run.total = run.actors - 1;
+	} else if (strcmp(scenario->name, "zipf") == 0) {
+		run.total = ZIPF_SENDERS * run.messages;
+	} else {
+		run.total = run.actors * run.messages;
+	}
+	if (run.actors < 2 && run.scenario->go == NULL) {
+		return -1;
+	}
+	if (run.total == 0) {
+		return -1;
+	}
+	run.stride = run.total / LATENCY_SAMPLES + 1;
+
+	if (scenario->go == NULL) {
+		run.spawned_nsec = calloc(run.actors, sizeof(uint64_t));
+		return run.spawned_nsec == NULL ? -1 : 0;
+	}
+
+	run.peers = calloc(run.actors, sizeof(actor_id_t));
+	if (run.peers == NULL) {
+		return -1;
+	}
+
+	if (scenario->go == zipf_go) {
+		size_t targets = run.actors - ZIPF_SENDERS;
+		run.zipf_cdf = calloc(targets, sizeof(double));
+		if (run.zipf_cdf == NULL) {
+			return -1;
+		}
+
+		double sum = 0;
+		for (size_t i = 0; i < targets; i++) {
+			sum += 1.0 / pow(i + 1, ZIPF_SKEW);
+			run.zipf_cdf[i] = sum;
+		}
+		for (size_t i = 0; i < targets; i++) {
+			run.zipf_cdf[i] /= sum;
+		}
+	}
+
+	return 0;
+}
+
+static int compare_latency(const void *a, const void *b) {
+	uint64_t x = *(const uint64_t *)a;
+	uint64_t y = *(const uint64_t *)b;
+
+	return (x > y) - (x < y);
+}
+
+static int run_scenario(const scenario_t *scenario, size_t workers, double scale) {
+	if (prepare(scenario, scale) != 0) {
+		return 1;
+	}
+
+	actor_system_config_t config = {0};
+	config.pool_size = workers;
+	config.cast_limit = run.actors + 1;
+
+	if (actor_system_create_ex(&run.root, &root_role, &config) != 0) {
+		return 1;
+	}
+	actor_system_join(run.root);
+
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+
+	size_t samples = atomic_load(&run.samples);
+	if (samples > LATENCY_SAMPLES) {
+		samples = LATENCY_SAMPLES;
+	}
+	qsort(run.latency, samples, sizeof(uint64_t), compare_latency);
+
+	size_t received = atomic_load(&run.received);
+	size_t failed = atomic_load(&run.failed);
+	double seconds = (run.end_nsec - run.start_nsec) / 1e9;
+	printf("%s workers=%zu actors=%zu messages=%zu failed=%zu seconds=%.3f msgs_per_sec=%.0f p50_us=%.1f p99_us=%.1f max_rss_kb=%ld\n",
+		scenario->name, workers, run.actors, received, failed, seconds, received / seconds,
+		samples ? run.latency[samples / 2] / 1e3 : 0, samples ? run.latency[samples * 99 / 100] / 1e3 : 0,
+		usage.ru_maxrss);
+
+	return received != run.total || failed != 0;
+}
+
+static int fork_scenario(const scenario_t *scenario, size_t workers, double scale) {
+	fflush(stdout);
+
+	pid_t child = fork();
+	if (child < 0) {
+		return 1;
+	}
+	if (child == 0) {
+		exit(run_scenario(scenario, workers, scale));
+	}
+
+	int status;
+	if (waitpid(child, &status, 0) != child || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+		printf("%s workers=%zu failed=1\n", scenario->name, workers);
+		return 1;
+	}
+
+	return 0;
+}
+
+static bool listed(const char *list, const char *name) {
+	if (strcmp(list, "all") == 0) {
+		return true;
+	}
+
+	size_t length = strlen(name);
+	for (const char *at = list; at != NULL; at = strchr(at, ',')) {
+		if (*at == ',') {
+			at++;
+		}
+		if (strncmp(at, name, length) == 0 && (at[length] == ',' || at[length] == '\0')) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+// cacti_bench [scenarios|all] [workers,...] [scale]
+int main(int argc, char **argv) {
+	const char *names = argc > 1 ? argv[1] : "all";
+	const char *workers = argc > 2 ? argv[2] : "1,2,4";
+	double scale = argc > 3 ? strtod(argv[3], NULL) : 1.0;
+
+	int failed = 0;
+	for (size_t i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); i++) {
+		if (!listed(names, scenarios[i].name)) {
+			continue;
+		}
+
+		const char *at = workers;
+		while (*at != '\0') {
+			char *end;
+			size_t count = strtoul(at, &end, 10);
+			if (end == at) {
+				return 2;
+			}
+			failed |= fork_scenario(&scenarios[i], count, scale);
+			at = *end == ',' ? end + 1 : end;
+		}
+	}
+
+	return failed;
+}
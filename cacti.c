@@ -1,3 +1,4 @@
+#define _GNU_SOURCE
 #include <pthread.h>
 #include <semaphore.h>
 #include <stddef.h>
@@ -7,400 +8,3439 @@
 #include <stdlib.h>
 #include <string.h>
 #include <signal.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <time.h>
 #include <errno.h>
 #include <unistd.h>
+#include <dirent.h>
+#include <ctype.h>
+#include <fcntl.h>
+#include <inttypes.h>
 #include "cacti.h"
 
 
-#define BASE_ACTORS_VECTOR_SIZE 64
+#define ACTOR_CHUNK_SIZE 1024
+#define BASE_READY_QUEUE_SIZE 64
+#define NODE_CACHE_BATCH 64
+#define NODE_POOL_LIMIT 65536
+#define BUFFER_MIN_SHIFT 6
+#define BUFFER_MAX_SHIFT 22
+#define BUFFER_POOL_BYTES ((size_t)16 << 20)
+#define BUFFER_POOL_CLOSED ((message_buffer_t *)1)
+#define WAIT_STRIPES 64
+#define GENERATION_MASK (((actor_id_t)1 << (63 - ACTOR_INDEX_BITS)) - 1)
+#define MAILBOX_CLOSED ((SIZE_MAX >> 1) + 1)
+#define WORKER_SPIN 4096
+#define WORKER_SPIN_BACKOFF 64
+#define CACHE_LINE 64
+#define SEND_BATCH 64
+#define TIMER_TICK_USEC 1000
+#define TIMER_LEVELS 4
+#define TIMER_SLOT_BITS 8
+#define TIMER_SLOTS (1 << TIMER_SLOT_BITS)
+#define TIMER_CHUNK_SIZE 1024
+#define METRICS_SAMPLE_MASK 15
+#define TRACE_RING_EVENTS 16384
+#define TRACE_SEQUENCE_BITS 40
+
+#if defined(__x86_64__) || defined(__i386__)
+#define cpu_relax() __builtin_ia32_pause()
+#else
+#define cpu_relax() ((void)0)
+#endif
 
 
 __thread actor_id_t current_actor_id = -1;
+static __thread actor_future_t *current_reply = NULL;
+#if CACTI_METRICS
+static __thread unsigned metrics_tick = 0;
+#endif
+
+static atomic_uint_fast64_t trace_serials = 0;
+static __thread struct trace_ring *trace_ring = NULL;
+static __thread uint64_t trace_serial = 0;
+
+
+// Buffers up to 1 << BUFFER_MAX_SHIFT bytes are rounded up to a power of two
+// and go back to the pool they came from, larger ones to the allocator.
+typedef struct message_buffer {
+	atomic_size_t refs;
+	size_t nbytes;
+	size_t size_class;
+	struct buffer_pool *pool;
+	struct message_buffer *next;
+	_Alignas(max_align_t) unsigned char data[];
+} message_buffer_t;
+
+
+// Every thread that allocates buffers has a pool of its own. The thread takes
+// buffers from its size classes and puts its own back without a lock; other
+// threads push what they release onto returned, which the owner empties once
+// a size class runs dry. No lock is shared between threads, let alone
+// between systems. refs counts the thread and its buffers that are out, so
+// the pool stays until the last of them is gone.
+typedef struct buffer_pool {
+	struct message_buffer *_Atomic returned;
+	atomic_size_t refs;
+	struct message_buffer *free[BUFFER_MAX_SHIFT + 1];
+	size_t count[BUFFER_MAX_SHIFT + 1];
+} buffer_pool_t;
+
+
+// A message together with the shared buffer it holds a reference to, if any.
+// Inline payloads are copied from inline_bytes into the mailbox node and the
+// prompt gets a pointer to that copy.
+typedef struct envelope {
+	message_t message;
+	message_buffer_t *buffer;
+	const void *inline_bytes;
+	actor_future_t *reply;
+	int lane;
+	uint64_t trace_id;
+} envelope_t;
+
+
+// Shared by the asking thread and the reply handle, the last one to let go
+// frees it. status stays 1 until the reply or a failure comes in.
+struct actor_future {
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	atomic_int refs;
+	int status;
+	message_t reply;
+	uint64_t deadline;
+};
+
+
+typedef struct mailbox_link {
+	struct mailbox_link *_Atomic next;
+} mailbox_link_t;
+
+
+// The link comes first, so a node can be told from its link with a cast.
+typedef struct mailbox_node {
+	mailbox_link_t link;
+	envelope_t envelope;
+#if CACTI_METRICS
+	uint64_t enqueued_nsec;
+#endif
+	_Alignas(max_align_t) unsigned char inline_data[MESSAGE_INLINE_SIZE];
+} mailbox_node_t;
+
+
+// Nodes that overflow a thread's cache go back to the pool of the system they
+// were used in, so independent systems share no lock. A thread's cache may
+// hold nodes of several systems; a node is plain memory to any of them.
+typedef struct node_pool {
+	pthread_mutex_t mutex;
+	mailbox_node_t *head;
+	size_t count;
+} node_pool_t;
+
+
+// Senders blocked on full mailboxes wait on one of a few stripes shared by
+// all actors of a system, so mailboxes do not carry their own mutex.
+typedef struct wait_stripe {
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+} wait_stripe_t;
+
+
+// Lanes are drained from the highest one down. MSG_SPAWN and MSG_GODIE go
+// to the system lane, which is never full, user messages to the other two.
+typedef enum mailbox_lane {
+	LANE_NORMAL,
+	LANE_HIGH,
+	LANE_SYSTEM,
+	MAILBOX_LANES
+} mailbox_lane_t;
+
+
+// Intrusive multi-producer single-consumer queue (D. Vyukov). Producers only
+// swap the head, the tail is owned by whichever worker has the actor scheduled.
+// pending counts the nodes that have been or are about to be linked.
+typedef struct lane {
+	mailbox_link_t *_Atomic head;
+	mailbox_link_t *tail;
+	mailbox_link_t stub;
+	atomic_size_t pending;
+} lane_t;
+
+
+// count and capacity cover the user lanes only, system_count the system lane.
+// Under MAILBOX_DROP_OLDEST senders pop the user lanes too, to shed what went
+// over capacity, so every pop from those lanes holds pop_lock.
+typedef struct mailbox {
+	lane_t lanes[MAILBOX_LANES];
+	atomic_bool pop_lock;
+	atomic_size_t count;
+	atomic_size_t system_count;
+	atomic_size_t capacity;
+	atomic_int policy;
+	atomic_size_t waiters;
+	wait_stripe_t *stripe;
+#if CACTI_METRICS
+	_Atomic uint64_t dropped;
+#endif
+} mailbox_t;
+
+
+#if CACTI_METRICS
+// Every counter below has a single writer at a time, readers only want a
+// recent value, so relaxed loads and stores do.
+typedef struct histogram {
+	_Atomic uint64_t count;
+	_Atomic uint64_t max_nsec;
+	_Atomic uint64_t buckets[ACTOR_HISTOGRAM_BUCKETS];
+} histogram_t;
+
+
+typedef struct worker_metrics {
+	_Atomic uint64_t processed;
+	_Atomic uint64_t steals;
+	_Atomic uint64_t parks;
+	_Atomic uint64_t busy_nsec;
+	histogram_t queue_wait;
+	histogram_t handler;
+} worker_metrics_t;
+
+
+// Kept by the worker running the actor. What was enqueued follows from what
+// was processed, dropped and is still waiting, so senders count nothing.
+typedef struct actor_metrics {
+	_Atomic uint64_t processed;
+	atomic_size_t max_depth;
+} actor_metrics_t;
+#endif
+
+
+// An actor sits in at most one ready queue and runs on at most one worker.
+// Senders move it IDLE -> SCHEDULED (and enqueue it) or RUNNING -> NOTIFIED,
+// the worker that pops it owns it until it leaves RUNNING/NOTIFIED. A FREE
+// slot waits on the free list and is never scheduled, an UNUSED one has never
+// held an actor.
+typedef enum actor_state {
+	ACTOR_UNUSED,
+	ACTOR_IDLE,
+	ACTOR_SCHEDULED,
+	ACTOR_RUNNING,
+	ACTOR_NOTIFIED,
+	ACTOR_FREE
+} actor_state_t;
 
 
 typedef struct actor {
 	actor_id_t id;
-	void **state_ptr;
+	void *user_state;
 	role_t *role;
-	pthread_mutex_t *actor_mutex;
-	message_t *jobs;
-	size_t job_count;
-	size_t job_index;
-	size_t job_insert_index;
-	bool is_dead;
+	mailbox_t mailbox;
+	atomic_bool is_dead;
+	atomic_int state;
+	atomic_long generation;
+	atomic_size_t senders;
+	atomic_long last_worker;
+	actor_id_t next_free;
+#if CACTI_METRICS
+	actor_metrics_t metrics;
+#endif
 } actor_t;
 
 
-typedef struct thread_manager {
-	actor_t *actors;
-	size_t actors_size;
-	size_t actor_count;
-	size_t dead_actor_count;
+// Timers live in chunks and link to each other by index, so a timer id is
+// the index tagged with a generation, just like an actor id.
+typedef struct wheel_timer {
+	long prev;
+	long next;
+	long slot;
+	uint64_t expires;
+	uint64_t period;
+	long generation;
+	bool cancelled;
+	actor_id_t actor;
+	message_t message;
+} wheel_timer_t;
+
+
+// Hierarchical timing wheel: level l holds the timers due within
+// TIMER_SLOTS^(l + 1) ticks, and a slot of level l + 1 is spread over level
+// l whenever level l wraps around. Everything is guarded by mutex.
+typedef struct timer_wheel {
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	pthread_t thread;
+	bool running;
+	bool stopping;
+	uint64_t start_usec;
+	uint64_t current;
+	size_t pending;
+	long slots[TIMER_LEVELS * TIMER_SLOTS];
+	wheel_timer_t **chunks;
+	size_t chunk_count;
+	size_t timer_count;
+	long free_head;
+} timer_wheel_t;
+
+
+typedef enum trace_kind {
+	TRACE_SEND,
+	TRACE_RUN
+} trace_kind_t;
+
+
+// Times are raw trace_ticks, converted when the trace is written. A send has
+// no end, a run is one prompt of actor and peer is unused.
+typedef struct trace_event {
+	uint64_t start;
+	uint64_t end;
+	actor_id_t actor;
+	actor_id_t peer;
+	message_type_t type;
+	uint64_t id;
+	uint32_t kind;
+} trace_event_t;
+
+
+// Written by its thread only. head counts every event ever written, so a
+// reader takes the last TRACE_RING_EVENTS of them and then drops the ones
+// the writer may have overwritten in the meantime. skip counts down the sends
+// left until the next one traced.
+typedef struct trace_ring {
+	struct trace_ring *next;
+	pthread_t thread;
+	uint32_t tid;
+	long worker;
+	size_t skip;
+	atomic_size_t head;
+	trace_event_t events[TRACE_RING_EVENTS];
+} trace_ring_t;
+
+
+// Every thread that sends or runs prompts in a traced system gets a ring of
+// its own. serial tells the rings of this system from those of earlier ones
+// at the same address.
+typedef struct tracer {
+	bool enabled;
+	uint64_t serial;
+	pthread_mutex_t mutex;
+	trace_ring_t *rings;
+	uint32_t ring_count;
+	uint64_t start_ticks;
+	uint64_t start_nsec;
+} tracer_t;
+
+
+// Pushes, pops and steals take the queue's own mutex and no other lock.
+typedef struct ready_queue {
+	pthread_mutex_t mutex;
+	actor_id_t *items;
+	size_t size;
+	size_t head;
+	size_t count;
+} ready_queue_t;
+
+
+// An idle worker spins for a while and then parks on its own semaphore.
+// Parked workers sit on the idle list of their system, so a sender wakes
+// exactly one of them instead of the whole pool.
+typedef struct worker {
+	struct actor_system *tm;
+	size_t index;
+	int cpu;
+	size_t node;
+	pthread_t thread;
+	ready_queue_t queue;
+	sem_t park;
+	bool park_ready;
+	size_t idle_slot;
+	bool is_parked;
+	// Bumped by every thread that schedules here and polled by idle workers,
+	// so it keeps a line of its own.
+	_Alignas(CACHE_LINE) atomic_size_t ready;
+	_Alignas(CACHE_LINE) atomic_size_t spawned;
+	atomic_size_t died;
+#if CACTI_METRICS
+	worker_metrics_t metrics;
+#endif
+} worker_t;
+
+
+// Every NUMA node fills chunks of its own, first touched by the worker that
+// spawns there, and keeps its own list of slots to recycle.
+typedef struct numa_node {
+	size_t cursor;
+	actor_id_t free_head;
+} numa_node_t;
+
+
+typedef struct actor_system {
+	actor_system_config_t config;
+	actor_t *_Atomic *chunks;
+	size_t *chunk_nodes;
+	size_t chunk_count;
+	size_t chunks_used;
+	atomic_size_t slot_count;
+	atomic_size_t actor_count;
+	atomic_size_t outside_spawned;
+	atomic_size_t outside_died;
+	numa_node_t *nodes;
+	size_t node_count;
+	wait_stripe_t wait_stripes[WAIT_STRIPES];
+	node_pool_t node_pool;
 	pthread_mutex_t *access_mutex;
-	pthread_cond_t *work_cond;
 	pthread_cond_t *finish_cond;
-	size_t job_count;
-	size_t working_count;
-	size_t actor_index;
-	pthread_t *threads;
+	unsigned start_epoch;
+	bool finished;
+	atomic_size_t next_queue;
+	worker_t *workers;
+	worker_t **idle;
+	atomic_size_t idle_count;
 	pthread_t *sig_thread;
+	timer_wheel_t timers;
+	tracer_t tracer;
+	struct actor_system *next_system;
 } thread_manager_t;
 
-thread_manager_t *tm;
+static thread_manager_t *default_tm = NULL;
+
+static pthread_mutex_t systems_mutex = PTHREAD_MUTEX_INITIALIZER;
+static thread_manager_t *systems = NULL;
+
+// SIGINT only bumps stop_epoch and writes a byte to stop_pipe, both safe in
+// a signal handler. Systems started in an earlier epoch are stopping, and the
+// stop thread wakes their parked workers to notice.
+static atomic_uint stop_epoch;
+static int stop_pipe[2] = {-1, -1};
+static pthread_once_t stop_once = PTHREAD_ONCE_INIT;
+
+static __thread worker_t *current_worker = NULL;
+
+static __thread bool in_timer_thread = false;
+
+
+static __thread mailbox_node_t *node_cache = NULL;
+static __thread size_t node_cache_count = 0;
+static __thread bool node_cache_registered = false;
+static pthread_key_t node_cache_key;
+static pthread_once_t node_cache_once = PTHREAD_ONCE_INIT;
 
 
-static void actor_destroy(actor_t *actor) {
-	if (actor->state_ptr != NULL) {
-		free(actor->state_ptr);
+// Runs as a thread leaves, when the systems it sent to may be gone already.
+static void node_cache_exit(void *arg) {
+	(void)arg;
+
+	while (node_cache != NULL) {
+		mailbox_node_t *node = node_cache;
+		node_cache = (mailbox_node_t *)atomic_load_explicit(&node->link.next, memory_order_relaxed);
+		free(node);
 	}
+	node_cache_count = 0;
+}
+
+
+static void node_cache_key_init() {
+	if (pthread_key_create(&node_cache_key, node_cache_exit) != 0) exit(1);
+}
+
+
+static void node_cache_register() {
+	pthread_once(&node_cache_once, node_cache_key_init);
+	if (pthread_setspecific(node_cache_key, &node_cache) != 0) exit(1);
+	node_cache_registered = true;
+}
 
-	if (actor->actor_mutex != NULL) {
-		pthread_mutex_destroy(actor->actor_mutex);
-		free(actor->actor_mutex);
+
+static mailbox_node_t *node_alloc(node_pool_t *pool) {
+	if (node_cache == NULL) {
+		if (!node_cache_registered) {
+			node_cache_register();
+		}
+
+		pthread_mutex_lock(&pool->mutex);
+		while (pool->head != NULL && node_cache_count < NODE_CACHE_BATCH) {
+			mailbox_node_t *node = pool->head;
+			pool->head = (mailbox_node_t *)atomic_load_explicit(&node->link.next, memory_order_relaxed);
+			pool->count--;
+			atomic_store_explicit(&node->link.next, (mailbox_link_t *)node_cache, memory_order_relaxed);
+			node_cache = node;
+			node_cache_count++;
+		}
+		pthread_mutex_unlock(&pool->mutex);
 	}
 
-	if (actor->jobs != NULL) {
-		free(actor->jobs);
+	if (node_cache == NULL) {
+		mailbox_node_t *node = malloc(sizeof(mailbox_node_t));
+		if (node == NULL) exit(1);
+		return node;
 	}
+
+	mailbox_node_t *node = node_cache;
+	node_cache = (mailbox_node_t *)atomic_load_explicit(&node->link.next, memory_order_relaxed);
+	node_cache_count--;
+
+	return node;
 }
 
 
-static void tm_destroy() {
-	if (tm == NULL) {
+static void node_cache_flush(node_pool_t *pool, size_t keep) {
+	if (node_cache_count <= keep) {
 		return;
 	}
 
-	for (size_t i = 0; i < tm->actor_count; i++) {
-		actor_destroy(&tm->actors[i]);
+	pthread_mutex_lock(&pool->mutex);
+	while (node_cache_count > keep) {
+		mailbox_node_t *node = node_cache;
+		node_cache = (mailbox_node_t *)atomic_load_explicit(&node->link.next, memory_order_relaxed);
+		node_cache_count--;
+
+		// Nodes beyond what a burst needs go back to the allocator.
+		if (pool->count >= NODE_POOL_LIMIT) {
+			free(node);
+			continue;
+		}
+
+		atomic_store_explicit(&node->link.next, (mailbox_link_t *)pool->head, memory_order_relaxed);
+		pool->head = node;
+		pool->count++;
 	}
-	free(tm->actors);
+	pthread_mutex_unlock(&pool->mutex);
+}
 
-	if (tm->access_mutex != NULL) {
-		pthread_mutex_destroy(tm->access_mutex);
-		free(tm->access_mutex);
+
+static void node_free(node_pool_t *pool, mailbox_node_t *node) {
+	if (!node_cache_registered) {
+		node_cache_register();
 	}
 
-	if (tm->work_cond != NULL) {
-		pthread_cond_destroy(tm->work_cond);
-		free(tm->work_cond);
+	atomic_store_explicit(&node->link.next, (mailbox_link_t *)node_cache, memory_order_relaxed);
+	node_cache = node;
+	node_cache_count++;
+
+	if (node_cache_count >= 2 * NODE_CACHE_BATCH) {
+		node_cache_flush(pool, NODE_CACHE_BATCH);
 	}
+}
 
-	if (tm->finish_cond != NULL) {
-		pthread_cond_destroy(tm->finish_cond);
-		free(tm->finish_cond);
+
+static pthread_key_t buffer_pool_key;
+static pthread_once_t buffer_pool_once = PTHREAD_ONCE_INIT;
+static __thread buffer_pool_t *buffer_pool = NULL;
+
+
+static message_buffer_t *buffer_of(void *data) {
+	return (message_buffer_t *)((unsigned char *)data - offsetof(message_buffer_t, data));
+}
+
+
+static void buffer_pool_put(buffer_pool_t *pool) {
+	if (atomic_fetch_sub_explicit(&pool->refs, 1, memory_order_acq_rel) == 1) {
+		free(pool);
 	}
+}
+
 
-	if (tm->threads != NULL) {
-		free(tm->threads);
+// Runs as the owner leaves. Buffers still out go to the allocator from then on.
+static void buffer_pool_exit(void *arg) {
+	buffer_pool_t *pool = arg;
+
+	message_buffer_t *buffer = atomic_exchange_explicit(&pool->returned, BUFFER_POOL_CLOSED, memory_order_acquire);
+	while (buffer != NULL) {
+		message_buffer_t *next = buffer->next;
+		free(buffer);
+		buffer = next;
 	}
 
-	if (tm->sig_thread != NULL) {
-		free(tm->sig_thread);
+	for (size_t size_class = 0; size_class <= BUFFER_MAX_SHIFT; size_class++) {
+		while ((buffer = pool->free[size_class]) != NULL) {
+			pool->free[size_class] = buffer->next;
+			free(buffer);
+		}
 	}
 
-	free(tm);
+	buffer_pool = NULL;
+	buffer_pool_put(pool);
 }
 
 
-static actor_id_t create_new_actor(role_t *const role) {
-	pthread_mutex_lock(tm->access_mutex);
+static void buffer_pool_key_init() {
+	if (pthread_key_create(&buffer_pool_key, buffer_pool_exit) != 0) exit(1);
+}
 
-	if (tm->actor_count == CAST_LIMIT) {
-		pthread_mutex_unlock(tm->access_mutex);
-		return -1;
+
+static buffer_pool_t *buffer_pool_get() {
+	if (buffer_pool == NULL) {
+		pthread_once(&buffer_pool_once, buffer_pool_key_init);
+
+		buffer_pool_t *pool = calloc(1, sizeof(buffer_pool_t));
+		if (pool == NULL) exit(1);
+		atomic_init(&pool->returned, NULL);
+		atomic_init(&pool->refs, 1);
+		if (pthread_setspecific(buffer_pool_key, pool) != 0) exit(1);
+
+		buffer_pool = pool;
 	}
 
-	if (tm->actor_count == tm->actors_size) {
-		tm->actors = realloc(tm->actors, 2 * tm->actors_size * sizeof(actor_t));
-		tm->actors_size *= 2;
+	return buffer_pool;
+}
+
+
+// Must be called by the owner. A size class holds at most BUFFER_POOL_BYTES,
+// the rest goes to the allocator.
+static void buffer_pool_keep(buffer_pool_t *pool, message_buffer_t *buffer) {
+	size_t size_class = buffer->size_class;
+	if (pool->count[size_class] >= BUFFER_POOL_BYTES >> size_class) {
+		free(buffer);
+		return;
 	}
 
-	actor_t *new_actor = &(tm->actors[tm->actor_count]);
+	buffer->next = pool->free[size_class];
+	pool->free[size_class] = buffer;
+	pool->count[size_class]++;
+}
 
-	new_actor->id = tm->actor_count;
 
-	new_actor->state_ptr = calloc(1, sizeof(void *));
-	if (new_actor->state_ptr == NULL) {
-		exit(1);
+// Must be called by the owner.
+static void buffer_pool_collect(buffer_pool_t *pool) {
+	if (atomic_load_explicit(&pool->returned, memory_order_relaxed) == NULL) {
+		return;
 	}
-	*(new_actor->state_ptr) = NULL;
 
-	new_actor->role = role;
+	message_buffer_t *buffer = atomic_exchange_explicit(&pool->returned, NULL, memory_order_acquire);
+	while (buffer != NULL) {
+		message_buffer_t *next = buffer->next;
+		buffer_pool_keep(pool, buffer);
+		buffer = next;
+	}
+}
 
-	new_actor->actor_mutex = calloc(1, sizeof(pthread_mutex_t));
-	if (new_actor->actor_mutex == NULL) exit(1);
-	if (pthread_mutex_init(new_actor->actor_mutex, NULL) == -1) exit(1);
 
-	new_actor->jobs = calloc(ACTOR_QUEUE_LIMIT, sizeof(message_t));
-	if (new_actor->jobs == NULL) {
-		exit(1);
+void *message_buffer_alloc(size_t nbytes) {
+	size_t size_class = BUFFER_MIN_SHIFT;
+	while (size_class <= BUFFER_MAX_SHIFT && ((size_t)1 << size_class) < nbytes) {
+		size_class++;
 	}
-	new_actor->job_count = 0;
-	new_actor->job_index = 0;
-	new_actor->job_insert_index = 0;
-	new_actor->is_dead = false;
 
-	tm->actor_count++;
+	message_buffer_t *buffer = NULL;
+	buffer_pool_t *pool = NULL;
+	if (size_class <= BUFFER_MAX_SHIFT) {
+		pool = buffer_pool_get();
+		if (pool->free[size_class] == NULL) {
+			buffer_pool_collect(pool);
+		}
 
-	pthread_mutex_unlock(tm->access_mutex);
+		buffer = pool->free[size_class];
+		if (buffer != NULL) {
+			pool->free[size_class] = buffer->next;
+			pool->count[size_class]--;
+		} else {
+			buffer = malloc(sizeof(message_buffer_t) + ((size_t)1 << size_class));
+		}
+	} else {
+		buffer = malloc(sizeof(message_buffer_t) + nbytes);
+	}
 
-	return new_actor->id;
+	if (buffer == NULL) {
+		return NULL;
+	}
+
+	if (pool != NULL) {
+		atomic_fetch_add_explicit(&pool->refs, 1, memory_order_relaxed);
+	}
+	atomic_init(&buffer->refs, 1);
+	buffer->nbytes = nbytes;
+	buffer->size_class = size_class;
+	buffer->pool = pool;
+
+	return buffer->data;
+}
+
+
+void message_buffer_retain(void *data) {
+	atomic_fetch_add_explicit(&buffer_of(data)->refs, 1, memory_order_relaxed);
+}
+
+
+// The last reference puts the buffer back into its pool, straight away on
+// the owner's thread and through returned on any other.
+static void buffer_release(message_buffer_t *buffer) {
+	if (atomic_fetch_sub_explicit(&buffer->refs, 1, memory_order_acq_rel) != 1) {
+		return;
+	}
+
+	buffer_pool_t *pool = buffer->pool;
+	if (pool == NULL) {
+		free(buffer);
+		return;
+	}
+
+	if (pool == buffer_pool) {
+		buffer_pool_keep(pool, buffer);
+	} else {
+		message_buffer_t *head = atomic_load_explicit(&pool->returned, memory_order_relaxed);
+		do {
+			if (head == BUFFER_POOL_CLOSED) {
+				free(buffer);
+				break;
+			}
+			buffer->next = head;
+		} while (!atomic_compare_exchange_weak_explicit(&pool->returned, &head, buffer,
+				memory_order_release, memory_order_relaxed));
+	}
+
+	buffer_pool_put(pool);
+}
+
+
+void message_buffer_release(void *data) {
+	buffer_release(buffer_of(data));
 }
 
 
-static message_t *tm_job_get() {
-	for (size_t steps = 0; steps < tm->actor_count; steps++) {
-		pthread_mutex_lock(tm->actors[tm->actor_index].actor_mutex);
+size_t message_buffer_size(void *data) {
+	return buffer_of(data)->nbytes;
+}
 
-		actor_t *curr_actor = &(tm->actors[tm->actor_index]);
 
-		if (curr_actor->job_count > 0) {
-			message_t *job = &(curr_actor->jobs[curr_actor->job_index]);
+static uint64_t clock_usec() {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
 
-			current_actor_id = curr_actor->id;
-			curr_actor->job_index = (curr_actor->job_index + 1) % ACTOR_QUEUE_LIMIT;
-			curr_actor->job_count--;
-			tm->job_count--;
+	return (uint64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
 
-			pthread_mutex_unlock(tm->actors[tm->actor_index].actor_mutex);
 
-			tm->actor_index = (tm->actor_index + 1) % tm->actor_count;
+static uint64_t clock_nsec() {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
 
-			return job;
-		}
+	return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
 
-		pthread_mutex_unlock(tm->actors[tm->actor_index].actor_mutex);
 
-		tm->actor_index = (tm->actor_index + 1) % tm->actor_count;
+// Traces read the time counter directly, it is cheaper than clock_gettime
+// and is scaled to nanoseconds once, when the trace is written.
+static uint64_t trace_ticks() {
+#if defined(__x86_64__) || defined(__i386__)
+	return __builtin_ia32_rdtsc();
+#else
+	return clock_nsec();
+#endif
+}
+
+
+#if CACTI_METRICS
+static void counter_add(_Atomic uint64_t *counter, uint64_t n) {
+	atomic_store_explicit(counter, atomic_load_explicit(counter, memory_order_relaxed) + n, memory_order_relaxed);
+}
+
+
+static size_t histogram_bucket(uint64_t nsec) {
+	if (nsec < 8) {
+		return nsec;
 	}
 
-	return NULL;
+	int exp = 63 - __builtin_clzll(nsec);
+	size_t bucket = (size_t)(exp - 2) * 8 + ((nsec >> (exp - 3)) & 7);
+
+	return bucket < ACTOR_HISTOGRAM_BUCKETS ? bucket : ACTOR_HISTOGRAM_BUCKETS - 1;
 }
 
 
-static void handle_sigint() {
-	pthread_mutex_lock(tm->access_mutex);
+static void histogram_record(histogram_t *histogram, uint64_t nsec) {
+	counter_add(&histogram->buckets[histogram_bucket(nsec)], 1);
+	counter_add(&histogram->count, 1);
+	if (nsec > atomic_load_explicit(&histogram->max_nsec, memory_order_relaxed)) {
+		atomic_store_explicit(&histogram->max_nsec, nsec, memory_order_relaxed);
+	}
+}
 
-	for (size_t i = 0; i < tm->actor_count; i++) {
-		pthread_mutex_lock(tm->actors[i].actor_mutex);
 
-		if (!tm->actors[i].is_dead) {
-			tm->dead_actor_count++;
-		}
-		tm->actors[i].is_dead = true;
+static void histogram_merge(actor_histogram_t *into, histogram_t *histogram) {
+	for (size_t i = 0; i < ACTOR_HISTOGRAM_BUCKETS; i++) {
+		into->buckets[i] += atomic_load_explicit(&histogram->buckets[i], memory_order_relaxed);
+	}
+	into->count += atomic_load_explicit(&histogram->count, memory_order_relaxed);
 
-		pthread_mutex_unlock(tm->actors[i].actor_mutex);
+	uint64_t max = atomic_load_explicit(&histogram->max_nsec, memory_order_relaxed);
+	if (max > into->max_nsec) {
+		into->max_nsec = max;
 	}
-	
-	pthread_mutex_unlock(tm->access_mutex);
 }
+#endif
 
 
-static void *sig_thread_run() {
-	struct sigaction action;
-	sigset_t block_mask;
+static actor_future_t *future_create(long timeout_usec) {
+	actor_future_t *future = malloc(sizeof(actor_future_t));
+	if (future == NULL) {
+		return NULL;
+	}
 
-	sigemptyset(&block_mask);
-	sigaddset(&block_mask, SIGINT);
+	pthread_condattr_t attr;
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
 
-	action.sa_sigaction = handle_sigint;
-	action.sa_mask = block_mask;
-	action.sa_flags = 0;
+	if (pthread_mutex_init(&future->mutex, NULL) != 0) exit(1);
+	if (pthread_cond_init(&future->cond, &attr) != 0) exit(1);
+	pthread_condattr_destroy(&attr);
+
+	atomic_init(&future->refs, 2);
+	future->status = 1;
+	future->deadline = timeout_usec >= 0 ? clock_usec() + timeout_usec : 0;
+
+	return future;
+}
 
-	if (sigaction(SIGINT, &action, 0) == -1) exit(1);
 
-	for (int i = 0; i < POOL_SIZE; i++) {
-		pthread_join(tm->threads[i], NULL);
+static void future_put(actor_future_t *future) {
+	if (atomic_fetch_sub_explicit(&future->refs, 1, memory_order_acq_rel) != 1) {
+		return;
 	}
 
-	return NULL;
+	pthread_mutex_destroy(&future->mutex);
+	pthread_cond_destroy(&future->cond);
+	free(future);
 }
 
 
-static void *worker_thread_run() {
-	while (1) {
-		pthread_mutex_lock(tm->access_mutex);
+// Drops the reply handle's reference.
+static void future_resolve(actor_future_t *future, int status, message_t reply) {
+	pthread_mutex_lock(&future->mutex);
+	if (future->status == 1) {
+		future->status = status;
+		future->reply = reply;
+		pthread_cond_signal(&future->cond);
+	}
+	pthread_mutex_unlock(&future->mutex);
 
-		while (tm->job_count == 0 && tm->dead_actor_count < tm->actor_count) {
-			pthread_cond_wait(tm->work_cond, tm->access_mutex);
-		}
-		if (tm->job_count == 0 && tm->dead_actor_count >= tm->actor_count) {
-			break;
-		}
+	future_put(future);
+}
 
-		message_t *job = tm_job_get();
-		if (job != NULL) {
-			tm->working_count++;
-		}
 
-		pthread_mutex_unlock(tm->access_mutex);
+int actor_reply(actor_future_t *handle, message_t reply) {
+	if (handle == NULL) {
+		return -2;
+	}
+
+	future_resolve(handle, 0, reply);
+
+	return 0;
+}
+
+
+actor_future_t *actor_reply_handle() {
+	return current_reply;
+}
 
-		actor_t *actor = &(tm->actors[current_actor_id]);
 
-		if (job == NULL) {
+int actor_future_wait(actor_future_t *future, message_t *reply) {
+	pthread_mutex_lock(&future->mutex);
+
+	struct timespec deadline;
+	deadline.tv_sec = future->deadline / 1000000;
+	deadline.tv_nsec = (future->deadline % 1000000) * 1000;
+
+	int err = 0;
+	while (future->status == 1 && err != ETIMEDOUT) {
+		if (future->deadline == 0) {
+			pthread_cond_wait(&future->cond, &future->mutex);
+		} else {
+			err = pthread_cond_timedwait(&future->cond, &future->mutex, &deadline);
 		}
-		if (job != NULL) {
-			switch (job->message_type) {
-				case MSG_SPAWN: {
-					actor_id_t id = create_new_actor(job->data);
-					if (id == -1) {
-						break;
-					}
+	}
+
+	int status = future->status == 1 ? -5 : future->status;
+	if (status == 0 && reply != NULL) {
+		*reply = future->reply;
+	}
+
+	pthread_mutex_unlock(&future->mutex);
 
-					message_t message;
-					message.message_type = MSG_HELLO;
-					message.nbytes = job->nbytes;
-					message.data = (void *)actor_id_self();
+	return status;
+}
 
-					send_message(id, message);
 
-					break;
-				}
+void actor_future_free(actor_future_t *future) {
+	if (future != NULL) {
+		future_put(future);
+	}
+}
+
+
+static void lane_init(lane_t *lane) {
+	atomic_store_explicit(&lane->stub.next, NULL, memory_order_relaxed);
+	atomic_store_explicit(&lane->head, &lane->stub, memory_order_relaxed);
+	lane->tail = &lane->stub;
+	atomic_store_explicit(&lane->pending, 0, memory_order_relaxed);
+}
+
+
+static void mailbox_init(mailbox_t *mailbox, wait_stripe_t *stripe, size_t capacity, mailbox_policy_t policy) {
+	for (int lane = 0; lane < MAILBOX_LANES; lane++) {
+		lane_init(&mailbox->lanes[lane]);
+	}
+	atomic_store_explicit(&mailbox->pop_lock, false, memory_order_relaxed);
+	atomic_store_explicit(&mailbox->count, 0, memory_order_relaxed);
+	atomic_store_explicit(&mailbox->system_count, 0, memory_order_relaxed);
+	atomic_store_explicit(&mailbox->capacity, capacity, memory_order_relaxed);
+	atomic_store_explicit(&mailbox->policy, policy, memory_order_relaxed);
+	atomic_store_explicit(&mailbox->waiters, 0, memory_order_relaxed);
+	mailbox->stripe = stripe;
+#if CACTI_METRICS
+	atomic_store_explicit(&mailbox->dropped, 0, memory_order_relaxed);
+#endif
+}
+
+
+static bool mailbox_is_empty(mailbox_t *mailbox) {
+	return atomic_load(&mailbox->count) == 0 && atomic_load(&mailbox->system_count) == 0;
+}
+
+
+#if CACTI_METRICS
+static size_t mailbox_depth(mailbox_t *mailbox) {
+	return (atomic_load(&mailbox->count) & ~MAILBOX_CLOSED) + atomic_load(&mailbox->system_count);
+}
+#endif
+
 
-				case MSG_GODIE:
-					pthread_mutex_lock(tm->access_mutex);
-					pthread_mutex_lock(actor->actor_mutex);
+// The stripe is shared with other mailboxes, so every waiter has to recheck.
+static void mailbox_wake_senders(mailbox_t *mailbox) {
+	if (atomic_load(&mailbox->waiters) == 0) {
+		return;
+	}
+
+	pthread_mutex_lock(&mailbox->stripe->mutex);
+	pthread_cond_broadcast(&mailbox->stripe->cond);
+	pthread_mutex_unlock(&mailbox->stripe->mutex);
+}
+
+
+// The system lane ignores capacity and policy, it only has to back off from
+// a closed mailbox. Pairs with the check in tm_actor_release.
+static int mailbox_reserve_system(mailbox_t *mailbox) {
+	atomic_fetch_add(&mailbox->system_count, 1);
+	if (atomic_load(&mailbox->count) & MAILBOX_CLOSED) {
+		atomic_fetch_sub(&mailbox->system_count, 1);
+		return -1;
+	}
 
-					if (!actor->is_dead) {
-						tm->dead_actor_count++;
-					}
-					actor->is_dead = true;
+	return 0;
+}
 
 
-					pthread_mutex_unlock(actor->actor_mutex);
-					pthread_mutex_unlock(tm->access_mutex);
+// Takes one slot of the mailbox for a message that is about to be linked.
+// Returns -3 when the mailbox is full and its policy does not make room.
+// A sender blocked on a full mailbox gives up with -1 once the recipient dies
+// or its system, started in the given epoch, begins to stop.
+static int mailbox_reserve(mailbox_t *mailbox, int lane, bool try, bool may_block, atomic_bool *is_dead, unsigned epoch) {
+	if (lane == LANE_SYSTEM) {
+		return mailbox_reserve_system(mailbox);
+	}
 
-					break;
+	size_t count = atomic_load(&mailbox->count);
 
-				case MSG_HELLO:
-					actor->role->prompts[0](NULL, job->nbytes, job->data);
-					break;
+	while (1) {
+		if (count & MAILBOX_CLOSED) {
+			return -1;
+		}
 
-				default:
-					actor->role->prompts[job->message_type](actor->state_ptr, job->nbytes, job->data);
-					break;
+		size_t capacity = atomic_load(&mailbox->capacity);
+		if (count < capacity) {
+			if (atomic_compare_exchange_weak(&mailbox->count, &count, count + 1)) {
+				return 0;
 			}
+			continue;
 		}
-		
-		pthread_mutex_lock(tm->access_mutex);
-		tm->working_count--;
-		
-		current_actor_id = -1;
-		if (tm->working_count == 0 && tm->job_count == 0 && tm->dead_actor_count >= tm->actor_count) {
-			pthread_cond_broadcast(tm->work_cond);
+
+		if (try) {
+			return -3;
 		}
-		pthread_mutex_unlock(tm->access_mutex);
+
+		switch (atomic_load(&mailbox->policy)) {
+			// The sender sheds the oldest message once its own is linked.
+			case MAILBOX_DROP_OLDEST:
+				if (atomic_compare_exchange_weak(&mailbox->count, &count, count + 1)) {
+					return 0;
+				}
+				continue;
+
+			case MAILBOX_GROW:
+				if (capacity <= SIZE_MAX / 2) {
+					atomic_compare_exchange_strong(&mailbox->capacity, &capacity, 2 * capacity);
+				}
+				break;
+
+			case MAILBOX_BLOCK:
+				if (!may_block) {
+					return -3;
+				}
+
+				pthread_mutex_lock(&mailbox->stripe->mutex);
+				atomic_fetch_add(&mailbox->waiters, 1);
+				while (atomic_load(&mailbox->count) >= atomic_load(&mailbox->capacity)
+						&& atomic_load(&mailbox->policy) == MAILBOX_BLOCK
+						&& !atomic_load(is_dead) && atomic_load(&stop_epoch) == epoch) {
+					pthread_cond_wait(&mailbox->stripe->cond, &mailbox->stripe->mutex);
+				}
+				atomic_fetch_sub(&mailbox->waiters, 1);
+				pthread_mutex_unlock(&mailbox->stripe->mutex);
+
+				if (atomic_load(is_dead) || atomic_load(&stop_epoch) != epoch) {
+					return -1;
+				}
+				break;
+
+			default:
+				return -3;
+		}
+
+		count = atomic_load(&mailbox->count);
 	}
+}
 
-	pthread_mutex_unlock(tm->access_mutex);
-	
-	return NULL;
+
+static void lane_link(lane_t *lane, mailbox_link_t *link) {
+	atomic_store_explicit(&link->next, NULL, memory_order_relaxed);
+	mailbox_link_t *prev = atomic_exchange_explicit(&lane->head, link, memory_order_acq_rel);
+	atomic_store_explicit(&prev->next, link, memory_order_release);
 }
 
 
-actor_id_t actor_id_self() {
-	return current_actor_id;
+static void mailbox_lock(mailbox_t *mailbox) {
+	while (atomic_exchange_explicit(&mailbox->pop_lock, true, memory_order_acquire)) {
+		sched_yield();
+	}
 }
 
 
-int actor_system_create(actor_id_t *actor, role_t *const role) {
-	tm = calloc(1, sizeof(thread_manager_t));
-	if (tm == NULL) {
-		return -1;
+static void mailbox_unlock(mailbox_t *mailbox) {
+	atomic_store_explicit(&mailbox->pop_lock, false, memory_order_release);
+}
+
+
+// Returns NULL when the queue is empty or a producer has not linked its node yet.
+static mailbox_node_t *lane_try_pop(lane_t *lane) {
+	mailbox_link_t *tail = lane->tail;
+	mailbox_link_t *next = atomic_load_explicit(&tail->next, memory_order_acquire);
+
+	if (tail == &lane->stub) {
+		if (next == NULL) {
+			return NULL;
+		}
+		lane->tail = next;
+		tail = next;
+		next = atomic_load_explicit(&next->next, memory_order_acquire);
 	}
 
-	tm->actors = calloc(BASE_ACTORS_VECTOR_SIZE, sizeof(actor_t));
-	if (tm->actors == NULL) {
-		tm_destroy(); return -1;
+	if (next != NULL) {
+		lane->tail = next;
+		return (mailbox_node_t *)tail;
 	}
-	tm->actors_size = BASE_ACTORS_VECTOR_SIZE;
-	tm->actor_count = 0;
-	tm->dead_actor_count = 0;
 
-	tm->access_mutex = calloc(1, sizeof(pthread_mutex_t));
-	if (tm->access_mutex == NULL) {tm_destroy(); return -1;}
-	if (pthread_mutex_init(tm->access_mutex, NULL) == -1) {tm_destroy(); return -2;}
+	if (tail != atomic_load_explicit(&lane->head, memory_order_acquire)) {
+		return NULL;
+	}
 
-	tm->work_cond = calloc(1, sizeof(pthread_cond_t));
-	if (tm->work_cond == NULL) {tm_destroy(); return -1;}
-	if (pthread_cond_init(tm->work_cond, NULL) == -1) {tm_destroy(); return -2;}
+	lane_link(lane, &lane->stub);
 
-	tm->finish_cond = calloc(1, sizeof(pthread_cond_t));
-	if (tm->finish_cond == NULL) {tm_destroy(); return -1;}
-	if (pthread_cond_init(tm->finish_cond, NULL) == -1) {tm_destroy(); return -2;}
+	next = atomic_load_explicit(&tail->next, memory_order_acquire);
+	if (next != NULL) {
+		lane->tail = next;
+		return (mailbox_node_t *)tail;
+	}
 
-	*actor = create_new_actor(role);
+	return NULL;
+}
 
-	tm->job_count = 0;
-	tm->working_count = 0;
-	tm->actor_index = 0;
 
-	tm->threads = calloc(POOL_SIZE, sizeof(pthread_t));
-	if (tm->threads == NULL) {
-		{tm_destroy(); return -1;}
-	}
-	for (size_t i = 0; i < POOL_SIZE; i++) {
-		if (pthread_create(&(tm->threads[i]), NULL, worker_thread_run, NULL) == -1) {tm_destroy(); return -3;}
+// The node stays with the caller, who hands it to mailbox_node_done once the
+// message, and with it any inline payload, is no longer needed.
+static mailbox_node_t *mailbox_pop_lane(mailbox_t *mailbox, int index) {
+	lane_t *lane = &mailbox->lanes[index];
+	mailbox_node_t *node;
+	while ((node = lane_try_pop(lane)) == NULL) {
+		sched_yield();
 	}
 
-	tm->sig_thread = calloc(1, sizeof(pthread_t));
-	if (tm->sig_thread == NULL) {tm_destroy(); return -1;}
-	if (pthread_create(tm->sig_thread, NULL, sig_thread_run, NULL) == -1) {tm_destroy(); return -3;}
+	atomic_fetch_sub(&lane->pending, 1);
+	atomic_fetch_sub(index == LANE_SYSTEM ? &mailbox->system_count : &mailbox->count, 1);
 
-	message_t message;
-	message.message_type = MSG_HELLO;
-	message.nbytes = 1;
-	message.data = (void *)0;
+	return node;
+}
 
-	send_message(0, message);
 
-	return 0;
+// A reply handle still in the envelope was never given to a prompt, so the
+// ask fails.
+static void mailbox_node_done(node_pool_t *pool, mailbox_node_t *node) {
+	if (node->envelope.buffer != NULL) {
+		buffer_release(node->envelope.buffer);
+	}
+	if (node->envelope.reply != NULL) {
+		future_resolve(node->envelope.reply, -1, (message_t){0, 0, NULL});
+	}
+
+	node_free(pool, node);
 }
 
 
-void actor_system_join(actor_id_t actor) {
-	if (tm == NULL) {
-		return;
+// Discards the oldest messages of the lowest lane until the mailbox is back
+// within its capacity, so a stalled consumer holds no more than that.
+static void mailbox_shed(mailbox_t *mailbox, node_pool_t *pool) {
+	mailbox_lock(mailbox);
+	while ((atomic_load(&mailbox->count) & ~MAILBOX_CLOSED) > atomic_load(&mailbox->capacity)) {
+		int lane = LANE_NORMAL;
+		while (lane < LANE_SYSTEM && atomic_load(&mailbox->lanes[lane].pending) == 0) {
+			lane++;
+		}
+		if (lane == LANE_SYSTEM) {
+			break;
+		}
+		mailbox_node_done(pool, mailbox_pop_lane(mailbox, lane));
+#if CACTI_METRICS
+		counter_add(&mailbox->dropped, 1);
+#endif
 	}
-	pthread_mutex_lock(tm->access_mutex);
-	if (actor < 0 || (size_t)actor >= tm->actor_count) {
-		pthread_mutex_unlock(tm->access_mutex);
-		return;
+	mailbox_unlock(mailbox);
+}
+
+
+// The slot must have been taken with mailbox_reserve on the same lane.
+static void mailbox_push(mailbox_t *mailbox, node_pool_t *pool, envelope_t envelope) {
+	mailbox_node_t *node = node_alloc(pool);
+	node->envelope = envelope;
+	if (envelope.inline_bytes != NULL) {
+		memcpy(node->inline_data, envelope.inline_bytes, envelope.message.nbytes);
+		node->envelope.message.data = node->inline_data;
 	}
-	pthread_mutex_unlock(tm->access_mutex);
+#if CACTI_METRICS
+	// Reading the clock costs about as much as the rest of a send, so each
+	// thread only times one in METRICS_SAMPLE_MASK + 1 of its messages.
+	node->enqueued_nsec = (++metrics_tick & METRICS_SAMPLE_MASK) == 0 ? clock_nsec() : 0;
+#endif
+
+	lane_t *lane = &mailbox->lanes[envelope.lane];
+	atomic_fetch_add(&lane->pending, 1);
+	lane_link(lane, &node->link);
+
+	if (envelope.lane != LANE_SYSTEM && atomic_load(&mailbox->policy) == MAILBOX_DROP_OLDEST
+			&& (atomic_load(&mailbox->count) & ~MAILBOX_CLOSED) > atomic_load(&mailbox->capacity)) {
+		mailbox_shed(mailbox, pool);
+	}
+}
 
-	pthread_join(*tm->sig_thread, NULL);
 
-	tm_destroy();
+// Must only be called by the consumer while the mailbox is not empty. A slot
+// may be reserved before its lane's pending goes up, so until some lane has
+// a node the consumer waits for the producer.
+static mailbox_node_t *mailbox_pop(mailbox_t *mailbox) {
+	while (1) {
+		if (atomic_load(&mailbox->lanes[LANE_SYSTEM].pending) > 0) {
+			return mailbox_pop_lane(mailbox, LANE_SYSTEM);
+		}
+
+		mailbox_lock(mailbox);
+		for (int lane = LANE_HIGH; lane >= LANE_NORMAL; lane--) {
+			if (atomic_load(&mailbox->lanes[lane].pending) > 0) {
+				mailbox_node_t *node = mailbox_pop_lane(mailbox, lane);
+				mailbox_unlock(mailbox);
+				mailbox_wake_senders(mailbox);
+				return node;
+			}
+		}
+		mailbox_unlock(mailbox);
+		sched_yield();
+	}
 }
 
 
-int send_message(actor_id_t actor, message_t message) {
-	pthread_mutex_lock(tm->access_mutex);
-	if (actor < 0 || (size_t)actor >= tm->actor_count) {
-		pthread_mutex_unlock(tm->access_mutex);
-		return -2;
+static void mailbox_destroy(mailbox_t *mailbox, node_pool_t *pool) {
+	if (atomic_load(&mailbox->count) & MAILBOX_CLOSED) {
+		return;
 	}
 
-	pthread_mutex_lock(tm->actors[actor].actor_mutex);
-	if (tm->actors[actor].is_dead) {
-		pthread_mutex_unlock(tm->access_mutex);
-		pthread_mutex_unlock(tm->actors[actor].actor_mutex);
-		return -1;
+	for (int lane = 0; lane < MAILBOX_LANES; lane++) {
+		while (atomic_load(&mailbox->lanes[lane].pending) > 0) {
+			mailbox_node_done(pool, mailbox_pop_lane(mailbox, lane));
+		}
 	}
+}
 
-	actor_t *recipient = &(tm->actors[actor]);
-	recipient->jobs[recipient->job_insert_index] = message;
-	recipient->job_insert_index = (recipient->job_insert_index + 1) % ACTOR_QUEUE_LIMIT;
-	tm->job_count++;
-	recipient->job_count++;
 
-	pthread_mutex_unlock(tm->actors[actor].actor_mutex);
+static void actor_destroy(actor_t *actor, node_pool_t *pool) {
+	mailbox_destroy(&actor->mailbox, pool);
+}
+
 
-	if (tm->job_count == 1 && tm->working_count < POOL_SIZE) {
-		pthread_cond_signal(tm->work_cond);
+static int ready_queue_init(ready_queue_t *queue) {
+	queue->items = calloc(BASE_READY_QUEUE_SIZE, sizeof(actor_id_t));
+	if (queue->items == NULL) {
+		return -1;
 	}
-	pthread_mutex_unlock(tm->access_mutex);
+	queue->size = BASE_READY_QUEUE_SIZE;
+	queue->head = 0;
+	queue->count = 0;
+
+	if (pthread_mutex_init(&queue->mutex, NULL) != 0) {
+		free(queue->items);
+		queue->items = NULL;
+		return -2;
+	}
+
+	return 0;
+}
+
+
+static void ready_queue_destroy(ready_queue_t *queue) {
+	if (queue->items == NULL) {
+		return;
+	}
+
+	pthread_mutex_destroy(&queue->mutex);
+	free(queue->items);
+	queue->items = NULL;
+}
+
+
+// Must be called with the queue's mutex held.
+static void ready_queue_grow(ready_queue_t *queue) {
+	actor_id_t *items = calloc(2 * queue->size, sizeof(actor_id_t));
+	if (items == NULL) exit(1);
+
+	for (size_t i = 0; i < queue->count; i++) {
+		items[i] = queue->items[(queue->head + i) % queue->size];
+	}
+
+	free(queue->items);
+	queue->items = items;
+	queue->size *= 2;
+	queue->head = 0;
+}
+
+
+static void ready_queue_push(ready_queue_t *queue, actor_id_t id) {
+	pthread_mutex_lock(&queue->mutex);
+
+	if (queue->count == queue->size) {
+		ready_queue_grow(queue);
+	}
+
+	queue->items[(queue->head + queue->count) % queue->size] = id;
+	queue->count++;
+
+	pthread_mutex_unlock(&queue->mutex);
+}
+
+
+static void ready_queue_push_many(ready_queue_t *queue, const actor_id_t *ids, size_t n) {
+	pthread_mutex_lock(&queue->mutex);
+
+	while (queue->count + n > queue->size) {
+		ready_queue_grow(queue);
+	}
+
+	for (size_t i = 0; i < n; i++) {
+		queue->items[(queue->head + queue->count) % queue->size] = ids[i];
+		queue->count++;
+	}
+
+	pthread_mutex_unlock(&queue->mutex);
+}
+
+
+static bool ready_queue_pop(ready_queue_t *queue, actor_id_t *id) {
+	pthread_mutex_lock(&queue->mutex);
+
+	if (queue->count == 0) {
+		pthread_mutex_unlock(&queue->mutex);
+		return false;
+	}
+
+	*id = queue->items[queue->head];
+	queue->head = (queue->head + 1) % queue->size;
+	queue->count--;
+
+	pthread_mutex_unlock(&queue->mutex);
+
+	return true;
+}
+
+
+static bool ready_queue_steal(ready_queue_t *queue, actor_id_t *id) {
+	pthread_mutex_lock(&queue->mutex);
+
+	if (queue->count == 0) {
+		pthread_mutex_unlock(&queue->mutex);
+		return false;
+	}
+
+	queue->count--;
+	*id = queue->items[(queue->head + queue->count) % queue->size];
+
+	pthread_mutex_unlock(&queue->mutex);
+
+	return true;
+}
+
+
+static void timer_wheel_destroy(timer_wheel_t *wheel);
+
+
+static void tm_destroy(thread_manager_t *tm) {
+	if (tm == NULL) {
+		return;
+	}
+
+	timer_wheel_destroy(&tm->timers);
+
+	if (tm->tracer.enabled) {
+		while (tm->tracer.rings != NULL) {
+			trace_ring_t *ring = tm->tracer.rings;
+			tm->tracer.rings = ring->next;
+			free(ring);
+		}
+		pthread_mutex_destroy(&tm->tracer.mutex);
+	}
+
+	size_t slot_count = atomic_load(&tm->slot_count);
+	for (size_t i = 0; i < slot_count; i++) {
+		actor_t *actor = &tm->chunks[i / ACTOR_CHUNK_SIZE][i % ACTOR_CHUNK_SIZE];
+		if (atomic_load(&actor->state) != ACTOR_UNUSED) {
+			actor_destroy(actor, &tm->node_pool);
+		}
+	}
+
+	if (tm->chunks != NULL) {
+		for (size_t i = 0; i < tm->chunk_count; i++) {
+			free(tm->chunks[i]);
+		}
+		free(tm->chunks);
+	}
+
+	if (tm->chunk_nodes != NULL) {
+		free(tm->chunk_nodes);
+	}
+
+	if (tm->nodes != NULL) {
+		free(tm->nodes);
+	}
+
+	if (tm->access_mutex != NULL) {
+		pthread_mutex_destroy(tm->access_mutex);
+		free(tm->access_mutex);
+	}
+
+	if (tm->finish_cond != NULL) {
+		pthread_cond_destroy(tm->finish_cond);
+		free(tm->finish_cond);
+	}
+
+	if (tm->workers != NULL) {
+		for (size_t i = 0; i < tm->config.pool_size; i++) {
+			ready_queue_destroy(&tm->workers[i].queue);
+			if (tm->workers[i].park_ready) {
+				sem_destroy(&tm->workers[i].park);
+			}
+		}
+		free(tm->workers);
+	}
+
+	if (tm->idle != NULL) {
+		free(tm->idle);
+	}
+
+	if (tm->sig_thread != NULL) {
+		free(tm->sig_thread);
+	}
+
+	for (size_t i = 0; i < WAIT_STRIPES; i++) {
+		pthread_mutex_destroy(&tm->wait_stripes[i].mutex);
+		pthread_cond_destroy(&tm->wait_stripes[i].cond);
+	}
+
+	while (tm->node_pool.head != NULL) {
+		mailbox_node_t *node = tm->node_pool.head;
+		tm->node_pool.head = (mailbox_node_t *)atomic_load_explicit(&node->link.next, memory_order_relaxed);
+		free(node);
+	}
+	pthread_mutex_destroy(&tm->node_pool.mutex);
+
+	free(tm);
+}
+
+
+// Returns the slot an id points to, whatever generation lives in it now.
+// Chunks are published before slot_count, and a slot's fields before it
+// leaves ACTOR_UNUSED.
+static actor_t *tm_actor_slot(thread_manager_t *tm, actor_id_t id) {
+	if (id < 0) {
+		return NULL;
+	}
+
+	size_t index = ACTOR_ID_INDEX(id);
+	if (index >= atomic_load_explicit(&tm->slot_count, memory_order_acquire)) {
+		return NULL;
+	}
+
+	actor_t *chunk = atomic_load_explicit(&tm->chunks[index / ACTOR_CHUNK_SIZE], memory_order_acquire);
+	actor_t *actor = &chunk[index % ACTOR_CHUNK_SIZE];
+	if (atomic_load(&actor->state) == ACTOR_UNUSED) {
+		return NULL;
+	}
+
+	return actor;
+}
+
+
+static size_t tm_actor_node(thread_manager_t *tm, actor_t *actor) {
+	return tm->chunk_nodes[ACTOR_ID_INDEX(actor->id) / ACTOR_CHUNK_SIZE];
+}
+
+
+static bool actor_is_stale(actor_t *actor, actor_id_t id) {
+	return atomic_load(&actor->generation) != ACTOR_ID_GENERATION(id);
+}
+
+
+static actor_t *tm_actor_get(thread_manager_t *tm, actor_id_t id) {
+	actor_t *actor = tm_actor_slot(tm, id);
+	if (actor == NULL || actor_is_stale(actor, id)) {
+		return NULL;
+	}
+
+	return actor;
+}
+
+
+// Must be called with access_mutex held. Senders pin a slot while they read
+// its generation and reserve a place in its mailbox, so once the generation
+// is bumped and the pins are gone, no message for the old id can get in.
+// A slot of another node is only taken when the spawning one has none.
+static actor_t *tm_actor_reuse(thread_manager_t *tm, size_t node) {
+	numa_node_t *owner = &tm->nodes[node];
+	for (size_t i = 0; owner->free_head == -1; i++) {
+		if (i == tm->node_count) {
+			return NULL;
+		}
+		owner = &tm->nodes[i];
+	}
+
+	actor_t *actor = tm_actor_slot(tm, owner->free_head);
+	owner->free_head = actor->next_free;
+
+	atomic_store(&actor->generation, (atomic_load(&actor->generation) + 1) & GENERATION_MASK);
+	while (atomic_load(&actor->senders) != 0) {
+		sched_yield();
+	}
+
+	return actor;
+}
+
+
+// Called by the worker that owns a dead actor. Closing an empty mailbox
+// rejects every later send, so the slot can go on the free list. A system
+// message that got in before the close reopens it.
+static bool tm_actor_release(thread_manager_t *tm, actor_t *actor) {
+	size_t empty = 0;
+	if (!atomic_compare_exchange_strong(&actor->mailbox.count, &empty, MAILBOX_CLOSED)) {
+		return false;
+	}
+	if (atomic_load(&actor->mailbox.system_count) != 0) {
+		atomic_store(&actor->mailbox.count, 0);
+		return false;
+	}
+
+	atomic_store(&actor->state, ACTOR_FREE);
+
+	pthread_mutex_lock(tm->access_mutex);
+	numa_node_t *owner = &tm->nodes[tm_actor_node(tm, actor)];
+	actor->next_free = owner->free_head;
+	owner->free_head = ACTOR_ID_INDEX(actor->id);
+	pthread_mutex_unlock(tm->access_mutex);
+
+	return true;
+}
+
+
+// Must be called with access_mutex held. Takes the next slot of the chunk
+// the node is filling, or opens a new chunk for it. Returns SIZE_MAX once
+// every chunk is in use.
+static size_t tm_slot_alloc(thread_manager_t *tm, size_t node) {
+	numa_node_t *owner = &tm->nodes[node];
+
+	if (owner->cursor % ACTOR_CHUNK_SIZE == 0) {
+		if (tm->chunks_used == tm->chunk_count) {
+			return SIZE_MAX;
+		}
+
+		// The spawning worker is the first to write to the chunk, so under the
+		// default first-touch policy its pages end up on that worker's node.
+		size_t index = tm->chunks_used++;
+		actor_t *chunk = calloc(ACTOR_CHUNK_SIZE, sizeof(actor_t));
+		if (chunk == NULL) {
+			exit(1);
+		}
+		tm->chunk_nodes[index] = node;
+
+		// Chunks are never moved, so lookups only have to see the chunk
+		// pointer published before slot_count.
+		atomic_store_explicit(&tm->chunks[index], chunk, memory_order_release);
+		atomic_store_explicit(&tm->slot_count, (index + 1) * ACTOR_CHUNK_SIZE, memory_order_release);
+		owner->cursor = index * ACTOR_CHUNK_SIZE;
+	}
+
+	return owner->cursor++;
+}
+
+
+// Actors are placed on the node of the worker that spawns them, the one they
+// are going to run on first. They are never moved after that, since the slot
+// is the actor's id; steals staying within a node keep them mostly local.
+static size_t tm_spawn_node(thread_manager_t *tm) {
+	worker_t *worker = current_worker;
+	if (worker == NULL || worker->tm != tm) {
+		return 0;
+	}
+
+	return worker->node;
+}
+
+
+// Spawns and deaths are counted by the thread that causes them: every worker
+// in counters of its own, threads outside the pool in shared ones. Nothing
+// sums them but an idle worker checking for the end and the stats, so no
+// send or prompt touches a counter the workers share.
+static void tm_count(thread_manager_t *tm, bool death) {
+	worker_t *worker = current_worker;
+	if (worker != NULL && worker->tm == tm) {
+		atomic_size_t *counter = death ? &worker->died : &worker->spawned;
+		atomic_store_explicit(counter, atomic_load_explicit(counter, memory_order_relaxed) + 1, memory_order_release);
+	} else {
+		atomic_fetch_add_explicit(death ? &tm->outside_died : &tm->outside_spawned, 1, memory_order_release);
+	}
+}
+
+
+// Deaths are summed first, so an actor that dies while the counters are read
+// is never missed among the spawned and taken for dead.
+static size_t tm_live_actors(thread_manager_t *tm) {
+	size_t died = atomic_load_explicit(&tm->outside_died, memory_order_acquire);
+	for (size_t i = 0; i < tm->config.pool_size; i++) {
+		died += atomic_load_explicit(&tm->workers[i].died, memory_order_acquire);
+	}
+
+	size_t spawned = atomic_load_explicit(&tm->outside_spawned, memory_order_acquire);
+	for (size_t i = 0; i < tm->config.pool_size; i++) {
+		spawned += atomic_load_explicit(&tm->workers[i].spawned, memory_order_acquire);
+	}
+
+	return spawned > died ? spawned - died : 0;
+}
+
+
+// Only workers about to park and the stats add the queues up; sends and pops
+// touch just the count of the queue they use.
+static size_t tm_ready_count(thread_manager_t *tm) {
+	size_t ready = 0;
+	for (size_t i = 0; i < tm->config.pool_size; i++) {
+		ready += atomic_load(&tm->workers[i].ready);
+	}
+
+	return ready;
+}
+
+
+static actor_id_t create_new_actor(thread_manager_t *tm, role_t *const role) {
+	pthread_mutex_lock(tm->access_mutex);
+
+	size_t actor_count = atomic_load_explicit(&tm->actor_count, memory_order_relaxed);
+	size_t node = tm_spawn_node(tm);
+
+	actor_t *new_actor = tm_actor_reuse(tm, node);
+	if (new_actor == NULL) {
+		size_t index = actor_count < tm->config.cast_limit ? tm_slot_alloc(tm, node) : SIZE_MAX;
+		if (index == SIZE_MAX) {
+			pthread_mutex_unlock(tm->access_mutex);
+			return -1;
+		}
+
+		new_actor = &tm->chunks[index / ACTOR_CHUNK_SIZE][index % ACTOR_CHUNK_SIZE];
+		new_actor->id = index;
+		atomic_init(&new_actor->generation, 0);
+		atomic_init(&new_actor->senders, 0);
+		atomic_store_explicit(&tm->actor_count, actor_count + 1, memory_order_relaxed);
+	}
+
+	size_t index = ACTOR_ID_INDEX(new_actor->id);
+	new_actor->id = (atomic_load(&new_actor->generation) << ACTOR_INDEX_BITS) | index;
+
+	new_actor->user_state = NULL;
+	new_actor->role = role;
+	atomic_store(&new_actor->last_worker, -1);
+
+	mailbox_init(&new_actor->mailbox, &tm->wait_stripes[index % WAIT_STRIPES],
+		tm->config.mailbox_capacity, tm->config.mailbox_policy);
+#if CACTI_METRICS
+	atomic_store_explicit(&new_actor->metrics.processed, 0, memory_order_relaxed);
+	atomic_store_explicit(&new_actor->metrics.max_depth, 0, memory_order_relaxed);
+#endif
+	atomic_store(&new_actor->is_dead, false);
+	atomic_store(&new_actor->state, ACTOR_IDLE);
+	tm_count(tm, false);
+
+	pthread_mutex_unlock(tm->access_mutex);
+
+	return new_actor->id;
+}
+
+
+// Returns true when the caller has to put the actor on a ready queue.
+static bool actor_notify(actor_t *actor) {
+	int state = atomic_load(&actor->state);
+
+	while (1) {
+		switch (state) {
+			case ACTOR_IDLE:
+				if (atomic_compare_exchange_weak(&actor->state, &state, ACTOR_SCHEDULED)) {
+					return true;
+				}
+				break;
+
+			case ACTOR_RUNNING:
+				if (atomic_compare_exchange_weak(&actor->state, &state, ACTOR_NOTIFIED)) {
+					return false;
+				}
+				break;
+
+			default:
+				return false;
+		}
+	}
+}
+
+
+static void actor_run_begin(actor_t *actor) {
+	int state = ACTOR_SCHEDULED;
+
+	if (!atomic_compare_exchange_strong(&actor->state, &state, ACTOR_RUNNING)) {
+		fprintf(stderr, "cacti: actor %ld dispatched in state %d\n", actor->id, state);
+		abort();
+	}
+}
+
+
+// Returns true when the actor has to go back on a ready queue. NOTIFIED may
+// refer to messages already drained by this run, so it is cleared before the
+// mailbox is checked; a sender that notifies after that fails the CAS below.
+static bool actor_run_end(actor_t *actor) {
+	atomic_store(&actor->state, ACTOR_RUNNING);
+
+	if (mailbox_is_empty(&actor->mailbox)) {
+		int state = ACTOR_RUNNING;
+		if (atomic_compare_exchange_strong(&actor->state, &state, ACTOR_IDLE)) {
+			return false;
+		}
+	}
+
+	atomic_store(&actor->state, ACTOR_SCHEDULED);
+
+	return true;
+}
+
+
+// A stopping system takes no more messages and spawns no more actors. Its
+// workers still run the messages already queued, asks included, and leave
+// once none is left, whether or not the actors died.
+static bool tm_is_stopping(thread_manager_t *tm) {
+	return atomic_load_explicit(&stop_epoch, memory_order_relaxed) != tm->start_epoch;
+}
+
+
+// Must be called with access_mutex held, by the last worker to park, which is
+// already on the idle list. Every other worker took the lock to park after its
+// last prompt, so its counters are settled, and with nothing ready no message
+// is waiting in any mailbox. All actors dead then means no prompt is left to
+// spawn or send.
+static bool tm_is_quiescent(thread_manager_t *tm) {
+	if (atomic_load(&tm->idle_count) != tm->config.pool_size) {
+		return false;
+	}
+
+	return tm_ready_count(tm) == 0 && (tm_is_stopping(tm) || tm_live_actors(tm) == 0);
+}
+
+
+// Must be called with access_mutex held.
+static void tm_idle_remove(thread_manager_t *tm, worker_t *worker) {
+	size_t idle_count = atomic_load_explicit(&tm->idle_count, memory_order_relaxed) - 1;
+	worker_t *last = tm->idle[idle_count];
+	tm->idle[worker->idle_slot] = last;
+	last->idle_slot = worker->idle_slot;
+	atomic_store(&tm->idle_count, idle_count);
+
+	worker->is_parked = false;
+}
+
+
+// Must be called with access_mutex held. The worker counts as idle before it
+// looks for work one last time, which pairs with the check in tm_schedule.
+static void tm_park(thread_manager_t *tm, worker_t *worker) {
+#if CACTI_METRICS
+	counter_add(&worker->metrics.parks, 1);
+#endif
+	size_t idle_count = atomic_load_explicit(&tm->idle_count, memory_order_relaxed);
+	worker->is_parked = true;
+	worker->idle_slot = idle_count;
+	tm->idle[idle_count] = worker;
+	atomic_store(&tm->idle_count, idle_count + 1);
+}
+
+
+// Must be called with access_mutex held, on a parked worker.
+static void tm_unpark(thread_manager_t *tm, worker_t *worker) {
+	tm_idle_remove(tm, worker);
+	sem_post(&worker->park);
+}
+
+
+// Must be called with access_mutex held. Wakes the preferred worker when it
+// is parked, and otherwise the one on its node that parked last, whose caches
+// are the least likely to have gone cold.
+static void tm_wake_one(thread_manager_t *tm, worker_t *preferred) {
+	if (preferred != NULL && preferred->is_parked) {
+		tm_unpark(tm, preferred);
+		return;
+	}
+
+	size_t idle_count = atomic_load_explicit(&tm->idle_count, memory_order_relaxed);
+	if (idle_count == 0) {
+		return;
+	}
+
+	for (size_t i = idle_count; preferred != NULL && i > 0; i--) {
+		if (tm->idle[i - 1]->node == preferred->node) {
+			tm_unpark(tm, tm->idle[i - 1]);
+			return;
+		}
+	}
+	tm_unpark(tm, tm->idle[idle_count - 1]);
+}
+
+
+// Must be called with access_mutex held.
+static void tm_wake_all(thread_manager_t *tm) {
+	size_t idle_count;
+	while ((idle_count = atomic_load_explicit(&tm->idle_count, memory_order_relaxed)) > 0) {
+		tm_unpark(tm, tm->idle[idle_count - 1]);
+	}
+}
+
+
+// A worker queues actors it makes runnable itself; other senders queue them
+// on the worker that ran them last. Only the queue's own lock is taken, and
+// access_mutex just when some worker is parked and needs waking. A queue's
+// ready count goes up before the push and down after the pop, so it never
+// falls short of what the queue holds.
+// Returns the worker whose queue the actor goes on. *preferred is the worker
+// that ran it last, NULL for an actor that never ran.
+static worker_t *tm_schedule_target(thread_manager_t *tm, actor_id_t id, worker_t **preferred) {
+	actor_t *actor = tm_actor_slot(tm, id);
+	long last = atomic_load_explicit(&actor->last_worker, memory_order_relaxed);
+	*preferred = last != -1 ? &tm->workers[last] : NULL;
+
+	worker_t *worker = current_worker;
+	if (worker == NULL || worker->tm != tm) {
+		worker = *preferred;
+	}
+	if (worker == NULL) {
+		size_t next = atomic_fetch_add_explicit(&tm->next_queue, 1, memory_order_relaxed);
+		worker = &tm->workers[next % tm->config.pool_size];
+	}
+
+	return worker;
+}
+
+
+static void tm_schedule(thread_manager_t *tm, actor_id_t id) {
+	worker_t *preferred;
+	worker_t *worker = tm_schedule_target(tm, id, &preferred);
+
+	atomic_fetch_add(&worker->ready, 1);
+	ready_queue_push(&worker->queue, id);
+
+	if (atomic_load(&tm->idle_count) > 0) {
+		pthread_mutex_lock(tm->access_mutex);
+		tm_wake_one(tm, preferred != NULL ? preferred : worker);
+		pthread_mutex_unlock(tm->access_mutex);
+	}
+}
+
+
+// Schedules up to SEND_BATCH actors at once. Each worker's share goes on its
+// queue under a single lock, and one pass under access_mutex wakes a parked
+// worker for every actor, as far as there are any.
+static void tm_schedule_batch(thread_manager_t *tm, const actor_id_t *ids, size_t n) {
+	if (n == 0) {
+		return;
+	}
+
+	worker_t *targets[SEND_BATCH];
+	for (size_t i = 0; i < n; i++) {
+		worker_t *preferred;
+		targets[i] = tm_schedule_target(tm, ids[i], &preferred);
+	}
+
+	worker_t *groups[SEND_BATCH];
+	size_t group_sizes[SEND_BATCH];
+	size_t group_count = 0;
+
+	for (size_t i = 0; i < n; i++) {
+		worker_t *worker = targets[i];
+		if (worker == NULL) {
+			continue;
+		}
+
+		actor_id_t group[SEND_BATCH];
+		size_t count = 0;
+		for (size_t j = i; j < n; j++) {
+			if (targets[j] == worker) {
+				group[count++] = ids[j];
+				targets[j] = NULL;
+			}
+		}
+
+		atomic_fetch_add(&worker->ready, count);
+		ready_queue_push_many(&worker->queue, group, count);
+
+		groups[group_count] = worker;
+		group_sizes[group_count++] = count;
+	}
+
+	if (atomic_load(&tm->idle_count) > 0) {
+		pthread_mutex_lock(tm->access_mutex);
+		for (size_t i = 0; i < group_count; i++) {
+			for (size_t j = 0; j < group_sizes[i] && atomic_load_explicit(&tm->idle_count, memory_order_relaxed) > 0; j++) {
+				tm_wake_one(tm, groups[i]);
+			}
+		}
+		pthread_mutex_unlock(tm->access_mutex);
+	}
+}
+
+
+// Returns false when no queue had an actor to give.
+static bool tm_job_get(thread_manager_t *tm, worker_t *worker, actor_id_t *id) {
+	if (ready_queue_pop(&worker->queue, id)) {
+		atomic_fetch_sub(&worker->ready, 1);
+		return true;
+	}
+
+	// Stealing across nodes drags the actor's memory along, so the worker's
+	// own node is searched first.
+	for (int remote = 0; remote < 2; remote++) {
+		for (size_t i = 1; i < tm->config.pool_size; i++) {
+			worker_t *victim = &tm->workers[(worker->index + i) % tm->config.pool_size];
+			if ((victim->node != worker->node) != remote) {
+				continue;
+			}
+			if (ready_queue_steal(&victim->queue, id)) {
+				atomic_fetch_sub(&victim->ready, 1);
+#if CACTI_METRICS
+				counter_add(&worker->metrics.steals, 1);
+#endif
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+
+// Returns NULL when the system is not traced or there is no memory for a ring.
+static trace_ring_t *trace_ring_get(thread_manager_t *tm) {
+	tracer_t *tracer = &tm->tracer;
+	if (!tracer->enabled) {
+		return NULL;
+	}
+	if (trace_serial == tracer->serial) {
+		return trace_ring;
+	}
+
+	// Threads that go back and forth between systems find their old ring.
+	pthread_t self = pthread_self();
+	pthread_mutex_lock(&tracer->mutex);
+	trace_ring_t *ring = tracer->rings;
+	while (ring != NULL && !pthread_equal(ring->thread, self)) {
+		ring = ring->next;
+	}
+	if (ring == NULL && (ring = calloc(1, sizeof(trace_ring_t))) != NULL) {
+		ring->thread = self;
+		ring->tid = tracer->ring_count++;
+		ring->worker = -1;
+		if (current_worker != NULL && current_worker->tm == tm) {
+			ring->worker = (long)current_worker->index;
+		} else if (in_timer_thread) {
+			ring->worker = -2;
+		}
+		ring->next = tracer->rings;
+		tracer->rings = ring;
+	}
+	pthread_mutex_unlock(&tracer->mutex);
+
+	if (ring != NULL) {
+		trace_ring = ring;
+		trace_serial = tracer->serial;
+	}
+
+	return ring;
+}
+
+
+static void trace_record(trace_ring_t *ring, trace_event_t event) {
+	size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+	ring->events[head % TRACE_RING_EVENTS] = event;
+	atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+}
+
+
+// Returns the id the message is known by in the trace, made of the ring and
+// the position of the send in it, or 0 for a send left out of the sample.
+// The clock read is most of what tracing a send costs, so only one in
+// trace_sample sends pays for it.
+static uint64_t trace_send(thread_manager_t *tm, trace_ring_t *ring, actor_id_t actor, message_type_t type) {
+	if (ring->skip != 0) {
+		ring->skip--;
+		return 0;
+	}
+	ring->skip = tm->config.trace_sample - 1;
+
+	actor_id_t sender = current_worker != NULL && current_worker->tm == tm ? current_actor_id : -1;
+	size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+	uint64_t id = (uint64_t)(ring->tid + 1) << TRACE_SEQUENCE_BITS | (head & (((uint64_t)1 << TRACE_SEQUENCE_BITS) - 1));
+
+	trace_record(ring, (trace_event_t){trace_ticks(), 0, sender, actor, type, id, TRACE_SEND});
+
+	return id;
+}
+
+
+// Queues the message but leaves scheduling the recipient to the caller, who
+// has to when *schedule is set. A successful send takes a reference to the
+// envelope's buffer, dropped once the recipient is done with the message.
+static int tm_deliver(thread_manager_t *tm, actor_id_t actor, envelope_t envelope, bool try, bool *schedule) {
+	actor_t *recipient = tm_actor_slot(tm, actor);
+	if (recipient == NULL) {
+		return -2;
+	}
+
+	message_type_t type = envelope.message.message_type;
+	if (type == MSG_SPAWN || type == MSG_GODIE) {
+		envelope.lane = LANE_SYSTEM;
+	}
+
+	bool pin = tm->config.recycle_actors;
+	if (pin) {
+		atomic_fetch_add(&recipient->senders, 1);
+	}
+
+	int err = 0;
+	if (tm_is_stopping(tm) || actor_is_stale(recipient, actor)
+			|| atomic_load_explicit(&recipient->is_dead, memory_order_acquire)) {
+		err = -1;
+	} else {
+		// Workers never block: the mailbox they wait on may need them to drain.
+		// Neither does the timer thread, every other timer would be late.
+		err = mailbox_reserve(&recipient->mailbox, envelope.lane, try, current_worker == NULL && !in_timer_thread,
+			&recipient->is_dead, tm->start_epoch);
+		if (err == 0) {
+			if (envelope.buffer != NULL) {
+				atomic_fetch_add_explicit(&envelope.buffer->refs, 1, memory_order_relaxed);
+			}
+			trace_ring_t *ring = trace_ring_get(tm);
+			if (ring != NULL) {
+				envelope.trace_id = trace_send(tm, ring, actor, type);
+			}
+			mailbox_push(&recipient->mailbox, &tm->node_pool, envelope);
+		}
+	}
+
+	if (pin) {
+		atomic_fetch_sub(&recipient->senders, 1);
+	}
+	if (err != 0) {
+		return err;
+	}
+
+	// The slot may have been recycled since, which at worst schedules the
+	// new actor with nothing to do.
+	*schedule = actor_notify(recipient);
+
+	return 0;
+}
+
+
+static int tm_send_envelope(thread_manager_t *tm, actor_id_t actor, envelope_t envelope, bool try) {
+	bool schedule;
+	int err = tm_deliver(tm, actor, envelope, try, &schedule);
+	if (err != 0) {
+		return err;
+	}
+
+	if (schedule) {
+		tm_schedule(tm, actor);
+	}
+
+	return 0;
+}
+
+
+static int tm_send(thread_manager_t *tm, actor_id_t actor, message_t message, bool try) {
+	return tm_send_envelope(tm, actor, (envelope_t){message, NULL, NULL, NULL, LANE_NORMAL, 0}, try);
+}
+
+
+// Returns how many actors got the message, each holding its own reference
+// to the envelope's buffer. Recipients are scheduled SEND_BATCH at a time.
+// A full mailbox may make the sender wait for its actor, which could be one
+// the batch holds back, so the batch goes out before that.
+static size_t tm_send_multi(thread_manager_t *tm, const actor_id_t *ids, size_t n, envelope_t envelope) {
+	actor_id_t scheduled[SEND_BATCH];
+	size_t count = 0;
+	size_t delivered = 0;
+
+	for (size_t i = 0; i < n; i++) {
+		bool schedule;
+		int err = tm_deliver(tm, ids[i], envelope, true, &schedule);
+		if (err == -3) {
+			tm_schedule_batch(tm, scheduled, count);
+			count = 0;
+			err = tm_deliver(tm, ids[i], envelope, false, &schedule);
+		}
+		if (err != 0) {
+			continue;
+		}
+		delivered++;
+
+		if (schedule) {
+			scheduled[count++] = ids[i];
+			if (count == SEND_BATCH) {
+				tm_schedule_batch(tm, scheduled, count);
+				count = 0;
+			}
+		}
+	}
+	tm_schedule_batch(tm, scheduled, count);
+
+	return delivered;
+}
+
+
+static size_t tm_broadcast(thread_manager_t *tm, envelope_t envelope) {
+	actor_id_t ids[SEND_BATCH];
+	size_t count = 0;
+	size_t delivered = 0;
+
+	size_t slot_count = atomic_load_explicit(&tm->slot_count, memory_order_acquire);
+	for (size_t i = 0; i < slot_count; i++) {
+		actor_t *actor = tm_actor_slot(tm, i);
+		if (actor == NULL || atomic_load(&actor->is_dead)) {
+			continue;
+		}
+
+		ids[count++] = (atomic_load(&actor->generation) << ACTOR_INDEX_BITS) | i;
+		if (count == SEND_BATCH) {
+			delivered += tm_send_multi(tm, ids, count, envelope);
+			count = 0;
+		}
+	}
+
+	return delivered + tm_send_multi(tm, ids, count, envelope);
+}
+
+
+static wheel_timer_t *timer_get(timer_wheel_t *wheel, long index) {
+	return &wheel->chunks[index / TIMER_CHUNK_SIZE][index % TIMER_CHUNK_SIZE];
+}
+
+
+static void timer_link(timer_wheel_t *wheel, long index) {
+	wheel_timer_t *timer = timer_get(wheel, index);
+
+	uint64_t delta = timer->expires > wheel->current ? timer->expires - wheel->current : 0;
+	int level = 0;
+	while (level + 1 < TIMER_LEVELS && delta >= (uint64_t)1 << (TIMER_SLOT_BITS * (level + 1))) {
+		level++;
+	}
+
+	// Timers beyond the last level wait in its farthest slot and cascade again.
+	uint64_t expires = timer->expires > wheel->current ? timer->expires : wheel->current;
+	if (delta >= (uint64_t)1 << (TIMER_SLOT_BITS * TIMER_LEVELS)) {
+		expires = wheel->current + ((uint64_t)1 << (TIMER_SLOT_BITS * TIMER_LEVELS)) - 1;
+	}
+
+	timer->slot = level * TIMER_SLOTS + ((expires >> (TIMER_SLOT_BITS * level)) & (TIMER_SLOTS - 1));
+	timer->prev = -1;
+	timer->next = wheel->slots[timer->slot];
+	if (timer->next != -1) {
+		timer_get(wheel, timer->next)->prev = index;
+	}
+	wheel->slots[timer->slot] = index;
+}
+
+
+static void timer_unlink(timer_wheel_t *wheel, long index) {
+	wheel_timer_t *timer = timer_get(wheel, index);
+
+	if (timer->prev != -1) {
+		timer_get(wheel, timer->prev)->next = timer->next;
+	} else {
+		wheel->slots[timer->slot] = timer->next;
+	}
+	if (timer->next != -1) {
+		timer_get(wheel, timer->next)->prev = timer->prev;
+	}
+	timer->slot = -1;
+}
+
+
+static void timer_free(timer_wheel_t *wheel, long index) {
+	wheel_timer_t *timer = timer_get(wheel, index);
+
+	timer->generation = (timer->generation + 1) & GENERATION_MASK;
+	timer->cancelled = false;
+	timer->next = wheel->free_head;
+	wheel->free_head = index;
+	wheel->pending--;
+}
+
+
+// Must be called with the wheel mutex held. Returns -1 when out of memory.
+static long timer_alloc(timer_wheel_t *wheel) {
+	if (wheel->free_head == -1) {
+		if (wheel->timer_count == wheel->chunk_count * TIMER_CHUNK_SIZE) {
+			size_t chunk_count = wheel->chunk_count == 0 ? 1 : 2 * wheel->chunk_count;
+			wheel_timer_t **chunks = realloc(wheel->chunks, chunk_count * sizeof(wheel_timer_t *));
+			if (chunks == NULL) {
+				return -1;
+			}
+			memset(chunks + wheel->chunk_count, 0, (chunk_count - wheel->chunk_count) * sizeof(wheel_timer_t *));
+			wheel->chunks = chunks;
+			wheel->chunk_count = chunk_count;
+		}
+
+		size_t chunk = wheel->timer_count / TIMER_CHUNK_SIZE;
+		if (wheel->chunks[chunk] == NULL) {
+			wheel->chunks[chunk] = calloc(TIMER_CHUNK_SIZE, sizeof(wheel_timer_t));
+			if (wheel->chunks[chunk] == NULL) {
+				return -1;
+			}
+		}
+
+		wheel->free_head = wheel->timer_count++;
+		timer_get(wheel, wheel->free_head)->next = -1;
+	}
+
+	long index = wheel->free_head;
+	wheel->free_head = timer_get(wheel, index)->next;
+	wheel->pending++;
+
+	return index;
+}
+
+
+static uint64_t timer_now(timer_wheel_t *wheel) {
+	return (clock_usec() - wheel->start_usec) / TIMER_TICK_USEC;
+}
+
+
+// Must be called with the wheel mutex held. Moves the timers due at the next
+// tick onto *due, linked by next.
+static void timer_tick(timer_wheel_t *wheel, long *due) {
+	wheel->current++;
+
+	for (int level = 1; level < TIMER_LEVELS; level++) {
+		if (((wheel->current >> (TIMER_SLOT_BITS * (level - 1))) & (TIMER_SLOTS - 1)) != 0) {
+			break;
+		}
+
+		long *slot = &wheel->slots[level * TIMER_SLOTS + ((wheel->current >> (TIMER_SLOT_BITS * level)) & (TIMER_SLOTS - 1))];
+		long index = *slot;
+		*slot = -1;
+		while (index != -1) {
+			long next = timer_get(wheel, index)->next;
+			timer_link(wheel, index);
+			index = next;
+		}
+	}
+
+	long *slot = &wheel->slots[wheel->current & (TIMER_SLOTS - 1)];
+	long index = *slot;
+	*slot = -1;
+	while (index != -1) {
+		wheel_timer_t *timer = timer_get(wheel, index);
+		long next = timer->next;
+
+		// Far timers parked in the last level may come around early.
+		if (timer->expires > wheel->current) {
+			timer_link(wheel, index);
+		} else {
+			timer->slot = -1;
+			timer->next = *due;
+			*due = index;
+		}
+		index = next;
+	}
+}
+
+
+static int tm_send(thread_manager_t *tm, actor_id_t actor, message_t message, bool try);
+
+
+static void *timer_thread_run(void *arg) {
+	thread_manager_t *tm = arg;
+	timer_wheel_t *wheel = &tm->timers;
+
+	in_timer_thread = true;
+
+	pthread_mutex_lock(&wheel->mutex);
+	while (!wheel->stopping) {
+		long due = -1;
+		uint64_t now = timer_now(wheel);
+		while (wheel->current < now) {
+			timer_tick(wheel, &due);
+		}
+
+		while (due != -1) {
+			wheel_timer_t *timer = timer_get(wheel, due);
+			long index = due;
+			due = timer->next;
+
+			int err = -1;
+			if (!timer->cancelled) {
+				actor_id_t actor = timer->actor;
+				message_t message = timer->message;
+
+				pthread_mutex_unlock(&wheel->mutex);
+				err = tm_send(tm, actor, message, false);
+				pthread_mutex_lock(&wheel->mutex);
+			}
+
+			// The timer may have been cancelled while the lock was down.
+			if (timer->period != 0 && !timer->cancelled && err != -1 && err != -2) {
+				timer->expires = wheel->current + timer->period;
+				timer_link(wheel, index);
+			} else {
+				timer_free(wheel, index);
+			}
+		}
+
+		// Sends drop the lock, so a stop may have come in meanwhile.
+		if (wheel->stopping) {
+			break;
+		}
+
+		if (wheel->pending == 0) {
+			pthread_cond_wait(&wheel->cond, &wheel->mutex);
+		} else {
+			uint64_t wake = wheel->start_usec + (wheel->current + 1) * TIMER_TICK_USEC;
+			struct timespec deadline;
+			deadline.tv_sec = wake / 1000000;
+			deadline.tv_nsec = (wake % 1000000) * 1000;
+			pthread_cond_timedwait(&wheel->cond, &wheel->mutex, &deadline);
+		}
+	}
+	pthread_mutex_unlock(&wheel->mutex);
+
+	return NULL;
+}
+
+
+static int timer_wheel_init(thread_manager_t *tm) {
+	timer_wheel_t *wheel = &tm->timers;
+
+	pthread_condattr_t attr;
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+
+	if (pthread_mutex_init(&wheel->mutex, NULL) != 0) exit(1);
+	if (pthread_cond_init(&wheel->cond, &attr) != 0) exit(1);
+	pthread_condattr_destroy(&attr);
+
+	for (size_t i = 0; i < TIMER_LEVELS * TIMER_SLOTS; i++) {
+		wheel->slots[i] = -1;
+	}
+	wheel->free_head = -1;
+	wheel->start_usec = clock_usec();
+
+	if (pthread_create(&wheel->thread, NULL, timer_thread_run, tm) != 0) {
+		return -3;
+	}
+	wheel->running = true;
+
+	return 0;
+}
+
+
+static void timer_wheel_destroy(timer_wheel_t *wheel) {
+	if (!wheel->running) {
+		return;
+	}
+
+	pthread_mutex_lock(&wheel->mutex);
+	wheel->stopping = true;
+	pthread_cond_signal(&wheel->cond);
+	pthread_mutex_unlock(&wheel->mutex);
+
+	pthread_join(wheel->thread, NULL);
+
+	for (size_t i = 0; i < wheel->chunk_count; i++) {
+		free(wheel->chunks[i]);
+	}
+	free(wheel->chunks);
+
+	pthread_mutex_destroy(&wheel->mutex);
+	pthread_cond_destroy(&wheel->cond);
+}
+
+
+static actor_timer_t tm_timer_start(thread_manager_t *tm, actor_id_t actor, message_t message, long delay_usec, long period_usec) {
+	timer_wheel_t *wheel = &tm->timers;
+
+	if (tm_actor_get(tm, actor) == NULL || delay_usec < 0 || period_usec < 0) {
+		return -1;
+	}
+
+	pthread_mutex_lock(&wheel->mutex);
+
+	// An idle wheel does not tick, so its clock restarts from the current tick.
+	if (wheel->pending == 0) {
+		wheel->start_usec = clock_usec() - wheel->current * TIMER_TICK_USEC;
+	}
+
+	long index = timer_alloc(wheel);
+	if (index == -1) {
+		pthread_mutex_unlock(&wheel->mutex);
+		return -1;
+	}
+
+	// Rounding up keeps timers from firing before their delay is over.
+	wheel_timer_t *timer = timer_get(wheel, index);
+	timer->expires = timer_now(wheel) + (delay_usec + TIMER_TICK_USEC - 1) / TIMER_TICK_USEC + 1;
+	timer->period = (period_usec + TIMER_TICK_USEC - 1) / TIMER_TICK_USEC;
+	timer->actor = actor;
+	timer->message = message;
+	timer_link(wheel, index);
+
+	if (wheel->pending == 1) {
+		pthread_cond_signal(&wheel->cond);
+	}
+
+	actor_timer_t id = (timer->generation << ACTOR_INDEX_BITS) | index;
+
+	pthread_mutex_unlock(&wheel->mutex);
+
+	return id;
+}
+
+
+static int tm_timer_cancel(thread_manager_t *tm, actor_timer_t id) {
+	timer_wheel_t *wheel = &tm->timers;
+	long index = ACTOR_ID_INDEX(id);
+	int err = -1;
+
+	pthread_mutex_lock(&wheel->mutex);
+
+	if (id >= 0 && (size_t)index < wheel->timer_count) {
+		wheel_timer_t *timer = timer_get(wheel, index);
+		if (timer->generation == ACTOR_ID_GENERATION(id) && !timer->cancelled) {
+			// A timer that is due is off the wheel, the timer thread frees it
+			// once it gets to it.
+			if (timer->slot != -1) {
+				timer_unlink(wheel, index);
+				timer_free(wheel, index);
+			} else {
+				timer->cancelled = true;
+			}
+			err = 0;
+		}
+	}
+
+	pthread_mutex_unlock(&wheel->mutex);
+
+	return err;
+}
+
+
+static void handle_sigint(int signal) {
+	(void)signal;
+
+	int saved_errno = errno;
+	char byte = 0;
+
+	atomic_fetch_add(&stop_epoch, 1);
+	if (write(stop_pipe[1], &byte, 1) == -1) {
+		// A full pipe already has a wakeup on the way.
+	}
+
+	errno = saved_errno;
+}
+
+
+// Parked workers and senders blocked on full mailboxes; workers that were
+// busy see the new epoch by themselves once they run out of messages.
+static void tm_wake_stopping(thread_manager_t *tm) {
+	pthread_mutex_lock(tm->access_mutex);
+	tm_wake_all(tm);
+	pthread_mutex_unlock(tm->access_mutex);
+
+	for (size_t i = 0; i < WAIT_STRIPES; i++) {
+		pthread_mutex_lock(&tm->wait_stripes[i].mutex);
+		pthread_cond_broadcast(&tm->wait_stripes[i].cond);
+		pthread_mutex_unlock(&tm->wait_stripes[i].mutex);
+	}
+}
+
+
+static void *stop_thread_run(void *arg) {
+	(void)arg;
+
+	char bytes[64];
+	while (1) {
+		ssize_t count = read(stop_pipe[0], bytes, sizeof(bytes));
+		if (count == -1 && errno == EINTR) {
+			continue;
+		}
+		if (count <= 0) {
+			return NULL;
+		}
+
+		pthread_mutex_lock(&systems_mutex);
+		for (thread_manager_t *tm = systems; tm != NULL; tm = tm->next_system) {
+			tm_wake_stopping(tm);
+		}
+		pthread_mutex_unlock(&systems_mutex);
+	}
+}
+
+
+static void stop_init() {
+	if (pipe2(stop_pipe, O_CLOEXEC) == -1) exit(1);
+	if (fcntl(stop_pipe[1], F_SETFL, O_NONBLOCK) == -1) exit(1);
+
+	pthread_t thread;
+	if (pthread_create(&thread, NULL, stop_thread_run, NULL) != 0) exit(1);
+	pthread_detach(thread);
+
+	struct sigaction action;
+	memset(&action, 0, sizeof(action));
+	action.sa_handler = handle_sigint;
+	sigemptyset(&action.sa_mask);
+	action.sa_flags = SA_RESTART;
+
+	if (sigaction(SIGINT, &action, 0) == -1) exit(1);
+}
+
+
+static void *sig_thread_run(void *arg) {
+	thread_manager_t *tm = arg;
+
+	for (size_t i = 0; i < tm->config.pool_size; i++) {
+		pthread_join(tm->workers[i].thread, NULL);
+	}
+
+	return NULL;
+}
+
+
+static void actor_handle(thread_manager_t *tm, actor_t *actor, message_t job) {
+	switch (job.message_type) {
+		case MSG_SPAWN: {
+			if (tm_is_stopping(tm)) {
+				break;
+			}
+
+			actor_id_t id = create_new_actor(tm, job.data);
+			if (id == -1) {
+				break;
+			}
+
+			message_t message;
+			message.message_type = MSG_HELLO;
+			message.nbytes = job.nbytes;
+			message.data = (void *)actor_id_self();
+
+			tm_send(tm, id, message, false);
+
+			break;
+		}
+
+		case MSG_GODIE:
+			if (!atomic_exchange(&actor->is_dead, true)) {
+				tm_count(tm, true);
+				mailbox_wake_senders(&actor->mailbox);
+			}
+
+			break;
+
+		case MSG_HELLO:
+			actor->role->prompts[0](&actor->user_state, job.nbytes, job.data);
+			break;
+
+		default:
+			actor->role->prompts[job.message_type](&actor->user_state, job.nbytes, job.data);
+			break;
+	}
+}
+
+
+// Drains up to batch_limit messages, or as many as fit in batch_usec, before
+// the actor goes back to a ready queue. The clock is read after every message,
+// so a batch ends within one message of its deadline however long prompts are.
+static void actor_run(thread_manager_t *tm, actor_t *actor) {
+	if (mailbox_is_empty(&actor->mailbox)) {
+		return;
+	}
+
+#if CACTI_METRICS
+	worker_metrics_t *metrics = &current_worker->metrics;
+	uint64_t started = clock_nsec();
+#else
+	uint64_t started = tm->config.batch_usec > 0 ? clock_nsec() : 0;
+#endif
+	uint64_t deadline = tm->config.batch_usec > 0 ? started + (uint64_t)tm->config.batch_usec * 1000 : 0;
+
+	trace_ring_t *ring = trace_ring_get(tm);
+	uint64_t ticks = ring != NULL ? trace_ticks() : 0;
+
+	size_t handled;
+	for (handled = 1; ; handled++) {
+#if CACTI_METRICS
+		size_t depth = mailbox_depth(&actor->mailbox);
+		if (depth > atomic_load_explicit(&actor->metrics.max_depth, memory_order_relaxed)) {
+			atomic_store_explicit(&actor->metrics.max_depth, depth, memory_order_relaxed);
+		}
+#endif
+
+		mailbox_node_t *node = mailbox_pop(&actor->mailbox);
+		message_type_t type = node->envelope.message.message_type;
+
+#if CACTI_METRICS
+		uint64_t handle_nsec = 0;
+		if (node->enqueued_nsec != 0) {
+			handle_nsec = clock_nsec();
+			histogram_record(&metrics->queue_wait, handle_nsec > node->enqueued_nsec ? handle_nsec - node->enqueued_nsec : 0);
+		}
+#endif
+
+		// The prompt owns the reply handle of an ask from here on.
+		if (type != MSG_SPAWN && type != MSG_GODIE) {
+			current_reply = node->envelope.reply;
+			node->envelope.reply = NULL;
+		}
+		actor_handle(tm, actor, node->envelope.message);
+		current_reply = NULL;
+
+#if CACTI_METRICS
+		if (handle_nsec != 0) {
+			histogram_record(&metrics->handler, clock_nsec() - handle_nsec);
+		}
+#endif
+
+		// A prompt's trace starts where the previous one ended, which saves
+		// reading the clock twice per message.
+		if (ring != NULL) {
+			uint64_t done = trace_ticks();
+			trace_record(ring, (trace_event_t){ticks, done, actor->id, -1, type, node->envelope.trace_id, TRACE_RUN});
+			ticks = done;
+		}
+
+		mailbox_node_done(&tm->node_pool, node);
+
+		if (handled >= tm->config.batch_limit || mailbox_is_empty(&actor->mailbox)) {
+			break;
+		}
+		if (deadline != 0 && clock_nsec() >= deadline) {
+			break;
+		}
+	}
+
+#if CACTI_METRICS
+	counter_add(&metrics->processed, handled);
+	counter_add(&metrics->busy_nsec, clock_nsec() - started);
+	// Released after the worker's counters, so a reader that sees the
+	// actor's messages processed sees them counted by the worker too.
+	atomic_fetch_add_explicit(&actor->metrics.processed, handled, memory_order_release);
+#else
+	(void)handled;
+#endif
+}
+
+
+static void *worker_thread_run(void *arg) {
+	worker_t *worker = arg;
+	thread_manager_t *tm = worker->tm;
+
+	current_worker = worker;
+
+	while (1) {
+		actor_id_t id;
+		if (tm_job_get(tm, worker, &id)) {
+			actor_t *actor = tm_actor_slot(tm, id);
+			actor_run_begin(actor);
+			current_actor_id = actor->id;
+			atomic_store_explicit(&actor->last_worker, worker->index, memory_order_relaxed);
+			actor_run(tm, actor);
+
+			bool requeue = false;
+			if (!tm->config.recycle_actors || !atomic_load(&actor->is_dead) || !tm_actor_release(tm, actor)) {
+				requeue = actor_run_end(actor);
+			}
+
+			if (requeue) {
+				tm_schedule(tm, current_actor_id);
+			}
+
+			current_actor_id = -1;
+			continue;
+		}
+
+		// Bursts usually bring more work within microseconds, so look for it
+		// without the lock before going to sleep. Every look reads the count
+		// of each worker, so they grow further apart, up to
+		// WORKER_SPIN_BACKOFF pauses.
+		size_t ready;
+		size_t pause = 1;
+		for (size_t spun = 0; (ready = tm_ready_count(tm)) == 0 && spun < WORKER_SPIN; spun += pause) {
+			if (pause < WORKER_SPIN_BACKOFF) {
+				pause *= 2;
+			}
+			for (size_t i = 0; i < pause; i++) {
+				cpu_relax();
+			}
+		}
+		if (ready != 0) {
+			continue;
+		}
+
+		pthread_mutex_lock(tm->access_mutex);
+
+		if (tm->finished) {
+			tm_wake_all(tm);
+			break;
+		}
+
+		tm_park(tm, worker);
+
+		// Work queued before this worker was on the idle list woke no one.
+		if (tm_ready_count(tm) != 0) {
+			tm_idle_remove(tm, worker);
+			pthread_mutex_unlock(tm->access_mutex);
+			continue;
+		}
+
+		// The last worker to go idle is the one to see the end, and wakes
+		// the others to leave too.
+		if (tm_is_quiescent(tm)) {
+			tm->finished = true;
+			tm_idle_remove(tm, worker);
+			tm_wake_all(tm);
+			break;
+		}
+
+		pthread_mutex_unlock(tm->access_mutex);
+
+		while (sem_wait(&worker->park) != 0) {}
+	}
+
+	pthread_mutex_unlock(tm->access_mutex);
+
+	node_cache_flush(&tm->node_pool, 0);
+
+	return NULL;
+}
+
+
+static thread_manager_t *tm_current() {
+	return current_worker != NULL ? current_worker->tm : default_tm;
+}
+
+
+actor_id_t actor_id_self() {
+	return current_actor_id;
+}
+
+
+actor_system_t *actor_system_self() {
+	return current_worker != NULL ? current_worker->tm : NULL;
+}
+
+
+static void tm_configure(thread_manager_t *tm, const actor_system_config_t *config) {
+	if (config != NULL) {
+		tm->config = *config;
+	}
+
+	if (tm->config.pool_size == 0) {
+		long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+		tm->config.pool_size = cpus > 0 ? (size_t)cpus : 1;
+	}
+	if (tm->config.mailbox_capacity == 0) {
+		tm->config.mailbox_capacity = ACTOR_QUEUE_LIMIT;
+	}
+	if (tm->config.cast_limit == 0) {
+		tm->config.cast_limit = CAST_LIMIT;
+	}
+	if (tm->config.batch_limit == 0) {
+		tm->config.batch_limit = ACTOR_BATCH_LIMIT;
+	}
+	if (tm->config.batch_usec == 0) {
+		tm->config.batch_usec = ACTOR_BATCH_USEC;
+	}
+	if (tm->config.trace_sample == 0) {
+		tm->config.trace_sample = ACTOR_TRACE_SAMPLE;
+	}
+}
+
+
+// Picks the CPU for a worker out of the ones the process is allowed to use.
+static int tm_worker_cpu(thread_manager_t *tm, size_t index) {
+	cpu_set_t allowed;
+	if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+		return -1;
+	}
+
+	int count = CPU_COUNT(&allowed);
+	if (count == 0) {
+		return -1;
+	}
+
+	int skip = (tm->config.cpu_offset + index) % count;
+	for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+		if (CPU_ISSET(cpu, &allowed) && skip-- == 0) {
+			return cpu;
+		}
+	}
+
+	return -1;
+}
+
+
+// Reads the node of a CPU from the nodeN link sysfs keeps in its directory,
+// 0 when there is none.
+static size_t cpu_numa_node(int cpu) {
+	char path[64];
+	snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d", cpu);
+
+	DIR *dir = opendir(path);
+	if (dir == NULL) {
+		return 0;
+	}
+
+	size_t node = 0;
+	struct dirent *entry;
+	while ((entry = readdir(dir)) != NULL) {
+		if (strncmp(entry->d_name, "node", 4) == 0 && isdigit((unsigned char)entry->d_name[4])) {
+			node = strtoul(entry->d_name + 4, NULL, 10);
+			break;
+		}
+	}
+	closedir(dir);
+
+	return node;
+}
+
+
+// With numa_nodes set the workers are split into that many nodes of
+// consecutive indices, whatever the hardware. Otherwise only pinned workers
+// know their node, unpinned ones all count as node 0.
+static int tm_topology_init(thread_manager_t *tm) {
+	tm->node_count = 1;
+
+	for (size_t i = 0; i < tm->config.pool_size; i++) {
+		worker_t *worker = &tm->workers[i];
+
+		worker->cpu = -1;
+		if (tm->config.pin_workers) {
+			worker->cpu = tm_worker_cpu(tm, i);
+		}
+
+		worker->node = 0;
+		if (tm->config.numa_nodes > 0) {
+			worker->node = i * tm->config.numa_nodes / tm->config.pool_size;
+		} else if (worker->cpu != -1) {
+			worker->node = cpu_numa_node(worker->cpu);
+		}
+
+		if (worker->node >= tm->node_count) {
+			tm->node_count = worker->node + 1;
+		}
+	}
+
+	tm->nodes = calloc(tm->node_count, sizeof(numa_node_t));
+	if (tm->nodes == NULL) {
+		return -1;
+	}
+	for (size_t i = 0; i < tm->node_count; i++) {
+		tm->nodes[i].cursor = 0;
+		tm->nodes[i].free_head = -1;
+	}
+
+	// Each node may leave one chunk partly filled.
+	tm->chunk_count = (tm->config.cast_limit + ACTOR_CHUNK_SIZE - 1) / ACTOR_CHUNK_SIZE + tm->node_count - 1;
+	tm->chunks = calloc(tm->chunk_count, sizeof(actor_t *));
+	tm->chunk_nodes = calloc(tm->chunk_count, sizeof(size_t));
+	if (tm->chunks == NULL || tm->chunk_nodes == NULL) {
+		return -1;
+	}
+	tm->chunks_used = 0;
+	atomic_init(&tm->slot_count, 0);
+
+	return 0;
+}
+
+
+static int tm_worker_start(worker_t *worker) {
+	pthread_attr_t attr;
+	if (pthread_attr_init(&attr) != 0) {
+		return -3;
+	}
+
+	if (worker->cpu != -1) {
+		cpu_set_t cpus;
+		CPU_ZERO(&cpus);
+		CPU_SET(worker->cpu, &cpus);
+		pthread_attr_setaffinity_np(&attr, sizeof(cpus), &cpus);
+	}
+
+	int err = pthread_create(&worker->thread, &attr, worker_thread_run, worker);
+	pthread_attr_destroy(&attr);
+
+	return err == 0 ? 0 : -3;
+}
+
+
+int actor_system_start(actor_system_t **system, actor_id_t *actor, role_t *const role, const actor_system_config_t *config) {
+	thread_manager_t *tm = calloc(1, sizeof(thread_manager_t));
+	if (tm == NULL) {
+		return -1;
+	}
+
+	for (size_t i = 0; i < WAIT_STRIPES; i++) {
+		if (pthread_mutex_init(&tm->wait_stripes[i].mutex, NULL) != 0) exit(1);
+		if (pthread_cond_init(&tm->wait_stripes[i].cond, NULL) != 0) exit(1);
+	}
+	if (pthread_mutex_init(&tm->node_pool.mutex, NULL) != 0) exit(1);
+
+	tm_configure(tm, config);
+
+	pthread_once(&stop_once, stop_init);
+	tm->start_epoch = atomic_load(&stop_epoch);
+
+	if (tm->config.trace_path != NULL) {
+		if (pthread_mutex_init(&tm->tracer.mutex, NULL) != 0) exit(1);
+		tm->tracer.serial = atomic_fetch_add(&trace_serials, 1) + 1;
+		tm->tracer.start_ticks = trace_ticks();
+		tm->tracer.start_nsec = clock_nsec();
+		tm->tracer.enabled = true;
+	}
+
+	atomic_init(&tm->actor_count, 0);
+	atomic_init(&tm->outside_spawned, 0);
+	atomic_init(&tm->outside_died, 0);
+
+	tm->access_mutex = calloc(1, sizeof(pthread_mutex_t));
+	if (tm->access_mutex == NULL) {tm_destroy(tm); return -1;}
+	if (pthread_mutex_init(tm->access_mutex, NULL) == -1) {tm_destroy(tm); return -2;}
+
+	tm->finish_cond = calloc(1, sizeof(pthread_cond_t));
+	if (tm->finish_cond == NULL) {tm_destroy(tm); return -1;}
+	if (pthread_cond_init(tm->finish_cond, NULL) == -1) {tm_destroy(tm); return -2;}
+
+	tm->finished = false;
+	atomic_init(&tm->next_queue, 0);
+
+	tm->workers = aligned_alloc(CACHE_LINE, tm->config.pool_size * sizeof(worker_t));
+	if (tm->workers == NULL) {
+		{tm_destroy(tm); return -1;}
+	}
+	memset(tm->workers, 0, tm->config.pool_size * sizeof(worker_t));
+	for (size_t i = 0; i < tm->config.pool_size; i++) {
+		tm->workers[i].tm = tm;
+		tm->workers[i].index = i;
+		int err = ready_queue_init(&tm->workers[i].queue);
+		if (err != 0) {tm_destroy(tm); return err;}
+		if (sem_init(&tm->workers[i].park, 0, 0) != 0) {tm_destroy(tm); return -2;}
+		tm->workers[i].park_ready = true;
+	}
+
+	if (tm_topology_init(tm) != 0) {tm_destroy(tm); return -1;}
+
+	*actor = create_new_actor(tm, role);
+
+	tm->idle = calloc(tm->config.pool_size, sizeof(worker_t *));
+	if (tm->idle == NULL) {tm_destroy(tm); return -1;}
+	atomic_init(&tm->idle_count, 0);
+	for (size_t i = 0; i < tm->config.pool_size; i++) {
+		if (tm_worker_start(&tm->workers[i]) != 0) {tm_destroy(tm); return -3;}
+	}
+
+	tm->sig_thread = calloc(1, sizeof(pthread_t));
+	if (tm->sig_thread == NULL) {tm_destroy(tm); return -1;}
+	if (pthread_create(tm->sig_thread, NULL, sig_thread_run, tm) == -1) {tm_destroy(tm); return -3;}
+
+	if (timer_wheel_init(tm) != 0) {tm_destroy(tm); return -3;}
+
+	// A signal that came before the system was on the list did not wake it.
+	pthread_mutex_lock(&systems_mutex);
+	tm->next_system = systems;
+	systems = tm;
+	if (tm_is_stopping(tm)) {
+		tm_wake_stopping(tm);
+	}
+	pthread_mutex_unlock(&systems_mutex);
+
+	*system = tm;
+
+	message_t message;
+	message.message_type = MSG_HELLO;
+	message.nbytes = 1;
+	message.data = (void *)0;
+
+	tm_send(tm, 0, message, false);
+
+	return 0;
+}
+
+
+int actor_system_create_ex(actor_id_t *actor, role_t *const role, const actor_system_config_t *config) {
+	return actor_system_start(&default_tm, actor, role, config);
+}
+
+
+int actor_system_create(actor_id_t *actor, role_t *const role) {
+	actor_system_config_t config;
+	memset(&config, 0, sizeof(config));
+
+	config.pool_size = POOL_SIZE;
+
+	return actor_system_create_ex(actor, role, &config);
+}
+
+
+static void trace_type_name(message_type_t type, char *name, size_t size) {
+	switch (type) {
+		case MSG_SPAWN:
+			snprintf(name, size, "spawn");
+			break;
+		case MSG_GODIE:
+			snprintf(name, size, "godie");
+			break;
+		case MSG_HELLO:
+			snprintf(name, size, "hello");
+			break;
+		default:
+			snprintf(name, size, "message %ld", type);
+			break;
+	}
+}
+
+
+// Copies what is left of the ring into events and returns how many there are.
+static size_t trace_ring_copy(trace_ring_t *ring, trace_event_t *events) {
+	size_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+	size_t first = head > TRACE_RING_EVENTS ? head - TRACE_RING_EVENTS : 0;
+	for (size_t i = first; i < head; i++) {
+		events[i - first] = ring->events[i % TRACE_RING_EVENTS];
+	}
+
+	size_t after = atomic_load_explicit(&ring->head, memory_order_acquire);
+	size_t valid = after > TRACE_RING_EVENTS ? after - TRACE_RING_EVENTS : 0;
+	if (valid <= first) {
+		return head - first;
+	}
+	if (valid >= head) {
+		return 0;
+	}
+
+	memmove(events, events + (valid - first), (head - valid) * sizeof(trace_event_t));
+	return head - valid;
+}
+
+
+// Chrome trace event format: a complete event per prompt, an instant event
+// per sampled send and a flow from it to the prompt that took the message.
+// Message ids are written as strings, JSON readers keep 53 bits of a number.
+static int tm_trace_write(thread_manager_t *tm, FILE *file) {
+	tracer_t *tracer = &tm->tracer;
+
+	trace_event_t *events = malloc(TRACE_RING_EVENTS * sizeof(trace_event_t));
+	if (events == NULL) {
+		return -1;
+	}
+
+	uint64_t ticks = trace_ticks() - tracer->start_ticks;
+	double usec_per_tick = ticks > 0 ? (clock_nsec() - tracer->start_nsec) / 1000.0 / ticks : 0.001;
+	int pid = getpid();
+	char name[32];
+
+	fprintf(file, "{\"traceEvents\":[\n");
+	const char *separator = "";
+
+	pthread_mutex_lock(&tracer->mutex);
+	for (trace_ring_t *ring = tracer->rings; ring != NULL; ring = ring->next) {
+		if (ring->worker >= 0) {
+			snprintf(name, sizeof(name), "worker %ld", ring->worker);
+		} else if (ring->worker == -2) {
+			snprintf(name, sizeof(name), "timers");
+		} else {
+			snprintf(name, sizeof(name), "thread %u", ring->tid);
+		}
+		fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+			separator, pid, ring->tid, name);
+		separator = ",\n";
+
+		size_t count = trace_ring_copy(ring, events);
+		for (size_t i = 0; i < count; i++) {
+			trace_event_t *event = &events[i];
+			double ts = (event->start - tracer->start_ticks) * usec_per_tick;
+			trace_type_name(event->type, name, sizeof(name));
+
+			if (event->kind == TRACE_SEND) {
+				fprintf(file, ",\n{\"name\":\"send\",\"cat\":\"send\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%.3f,\"pid\":%d,\"tid\":%u,"
+					"\"args\":{\"from\":%ld,\"to\":%ld,\"type\":\"%s\",\"message\":\"%" PRIu64 "\"}}",
+					ts, pid, ring->tid, event->actor, event->peer, name, event->id);
+				fprintf(file, ",\n{\"name\":\"message\",\"cat\":\"message\",\"ph\":\"s\",\"id\":\"%" PRIu64 "\",\"ts\":%.3f,\"pid\":%d,\"tid\":%u}",
+					event->id, ts, pid, ring->tid);
+			} else if (event->id == 0) {
+				double dur = (event->end - event->start) * usec_per_tick;
+				fprintf(file, ",\n{\"name\":\"%s\",\"cat\":\"prompt\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%d,\"tid\":%u,"
+					"\"args\":{\"actor\":%ld}}",
+					name, ts, dur, pid, ring->tid, event->actor);
+			} else {
+				double dur = (event->end - event->start) * usec_per_tick;
+				fprintf(file, ",\n{\"name\":\"%s\",\"cat\":\"prompt\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%d,\"tid\":%u,"
+					"\"args\":{\"actor\":%ld,\"message\":\"%" PRIu64 "\"}}",
+					name, ts, dur, pid, ring->tid, event->actor, event->id);
+				fprintf(file, ",\n{\"name\":\"message\",\"cat\":\"message\",\"ph\":\"f\",\"bp\":\"e\",\"id\":\"%" PRIu64 "\",\"ts\":%.3f,\"pid\":%d,\"tid\":%u}",
+					event->id, ts, pid, ring->tid);
+			}
+		}
+	}
+	pthread_mutex_unlock(&tracer->mutex);
+
+	fprintf(file, "\n],\"displayTimeUnit\":\"ns\"}\n");
+	free(events);
+
+	return 0;
+}
+
+
+int actor_system_trace_dump(actor_system_t *system, const char *path) {
+	thread_manager_t *tm = system;
+	if (tm == NULL) {
+		return -2;
+	}
+	if (!tm->tracer.enabled) {
+		return -1;
+	}
+
+	FILE *file = fopen(path, "w");
+	if (file == NULL) {
+		return -1;
+	}
+
+	int err = tm_trace_write(tm, file);
+	if (fclose(file) != 0) {
+		err = -1;
+	}
+
+	return err;
+}
+
+
+void actor_system_wait(actor_system_t *system, actor_id_t actor) {
+	thread_manager_t *tm = system;
+	if (tm == NULL) {
+		return;
+	}
+	if (tm_actor_slot(tm, actor) == NULL) {
+		return;
+	}
+
+	pthread_join(*tm->sig_thread, NULL);
+
+	pthread_mutex_lock(&systems_mutex);
+	thread_manager_t **link = &systems;
+	while (*link != tm) {
+		link = &(*link)->next_system;
+	}
+	*link = tm->next_system;
+	pthread_mutex_unlock(&systems_mutex);
+
+	if (default_tm == tm) {
+		default_tm = NULL;
+	}
+
+	if (tm->config.trace_path != NULL) {
+		actor_system_trace_dump(tm, tm->config.trace_path);
+	}
+
+	tm_destroy(tm);
+}
+
+
+void actor_system_join(actor_id_t actor) {
+	actor_system_wait(default_tm, actor);
+}
+
+
+int actor_system_send(actor_system_t *system, actor_id_t actor, message_t message) {
+	if (system == NULL) {
+		return -2;
+	}
+
+	return tm_send(system, actor, message, false);
+}
+
+
+int actor_system_send_try(actor_system_t *system, actor_id_t actor, message_t message) {
+	if (system == NULL) {
+		return -2;
+	}
+
+	return tm_send(system, actor, message, true);
+}
+
+
+static envelope_t shared_envelope(message_type_t type, void *data) {
+	message_buffer_t *buffer = buffer_of(data);
+	message_t message = {type, buffer->nbytes, data};
+
+	return (envelope_t){message, buffer, NULL, NULL, LANE_NORMAL, 0};
+}
+
+
+int actor_system_send_shared(actor_system_t *system, actor_id_t actor, message_type_t type, void *data) {
+	if (system == NULL) {
+		return -2;
+	}
+
+	return tm_send_envelope(system, actor, shared_envelope(type, data), false);
+}
+
+
+int actor_system_send_inline(actor_system_t *system, actor_id_t actor, message_type_t type, const void *bytes, size_t nbytes) {
+	if (system == NULL) {
+		return -2;
+	}
+	if (nbytes > MESSAGE_INLINE_SIZE) {
+		return -4;
+	}
+
+	message_t message = {type, nbytes, NULL};
+
+	return tm_send_envelope(system, actor, (envelope_t){message, NULL, bytes, NULL, LANE_NORMAL, 0}, false);
+}
+
+
+int actor_system_send_priority(actor_system_t *system, actor_id_t actor, message_t message, message_priority_t priority) {
+	if (system == NULL) {
+		return -2;
+	}
+
+	int lane = priority == MESSAGE_HIGH ? LANE_HIGH : LANE_NORMAL;
+
+	return tm_send_envelope(system, actor, (envelope_t){message, NULL, NULL, NULL, lane, 0}, false);
+}
+
+
+actor_future_t *actor_system_ask(actor_system_t *system, actor_id_t actor, message_t message, long timeout_usec) {
+	if (system == NULL) {
+		return NULL;
+	}
+
+	actor_future_t *future = future_create(timeout_usec);
+	if (future == NULL) {
+		return NULL;
+	}
+
+	if (tm_send_envelope(system, actor, (envelope_t){message, NULL, NULL, future, LANE_NORMAL, 0}, false) != 0) {
+		atomic_store(&future->refs, 1);
+		future_put(future);
+		return NULL;
+	}
+
+	return future;
+}
+
+
+actor_future_t *actor_ask(actor_id_t actor, message_t message, long timeout_usec) {
+	return actor_system_ask(tm_current(), actor, message, timeout_usec);
+}
+
+
+int send_message_inline(actor_id_t actor, message_type_t type, const void *bytes, size_t nbytes) {
+	return actor_system_send_inline(tm_current(), actor, type, bytes, nbytes);
+}
+
+
+int send_message_priority(actor_id_t actor, message_t message, message_priority_t priority) {
+	return actor_system_send_priority(tm_current(), actor, message, priority);
+}
+
+
+int send_message_shared(actor_id_t actor, message_type_t type, void *data) {
+	return actor_system_send_shared(tm_current(), actor, type, data);
+}
+
+
+size_t actor_system_send_multi(actor_system_t *system, const actor_id_t *actors, size_t n, message_t message) {
+	if (system == NULL) {
+		return 0;
+	}
+
+	return tm_send_multi(system, actors, n, (envelope_t){message, NULL, NULL, NULL, LANE_NORMAL, 0});
+}
+
+
+size_t actor_system_broadcast(actor_system_t *system, message_t message) {
+	if (system == NULL) {
+		return 0;
+	}
+
+	return tm_broadcast(system, (envelope_t){message, NULL, NULL, NULL, LANE_NORMAL, 0});
+}
+
+
+size_t actor_system_send_multi_shared(actor_system_t *system, const actor_id_t *actors, size_t n, message_type_t type, void *data) {
+	if (system == NULL) {
+		return 0;
+	}
+
+	return tm_send_multi(system, actors, n, shared_envelope(type, data));
+}
+
+
+size_t actor_system_broadcast_shared(actor_system_t *system, message_type_t type, void *data) {
+	if (system == NULL) {
+		return 0;
+	}
+
+	return tm_broadcast(system, shared_envelope(type, data));
+}
+
+
+size_t send_message_multi(const actor_id_t *actors, size_t n, message_t message) {
+	return actor_system_send_multi(tm_current(), actors, n, message);
+}
+
+
+size_t send_message_broadcast(message_t message) {
+	return actor_system_broadcast(tm_current(), message);
+}
+
+
+size_t send_message_multi_shared(const actor_id_t *actors, size_t n, message_type_t type, void *buffer) {
+	return actor_system_send_multi_shared(tm_current(), actors, n, type, buffer);
+}
+
+
+size_t send_message_broadcast_shared(message_type_t type, void *buffer) {
+	return actor_system_broadcast_shared(tm_current(), type, buffer);
+}
+
+
+actor_timer_t actor_system_send_after(actor_system_t *system, actor_id_t actor, message_t message, long delay_usec, long period_usec) {
+	if (system == NULL) {
+		return -1;
+	}
+
+	return tm_timer_start(system, actor, message, delay_usec, period_usec);
+}
+
+
+int actor_system_timer_cancel(actor_system_t *system, actor_timer_t timer) {
+	if (system == NULL) {
+		return -1;
+	}
+
+	return tm_timer_cancel(system, timer);
+}
+
+
+actor_timer_t send_message_after(actor_id_t actor, message_t message, long delay_usec) {
+	return actor_system_send_after(tm_current(), actor, message, delay_usec, 0);
+}
+
+
+actor_timer_t send_message_every(actor_id_t actor, message_t message, long delay_usec, long period_usec) {
+	return actor_system_send_after(tm_current(), actor, message, delay_usec, period_usec);
+}
+
+
+int actor_timer_cancel(actor_timer_t timer) {
+	return actor_system_timer_cancel(tm_current(), timer);
+}
+
+
+int send_message(actor_id_t actor, message_t message) {
+	return actor_system_send(tm_current(), actor, message);
+}
+
+
+int send_message_try(actor_id_t actor, message_t message) {
+	return actor_system_send_try(tm_current(), actor, message);
+}
+
+
+int actor_system_mailbox_configure(actor_system_t *system, actor_id_t actor, mailbox_policy_t policy, size_t capacity) {
+	thread_manager_t *tm = system;
+	if (tm == NULL) {
+		return -2;
+	}
+
+	actor_t *target = tm_actor_get(tm, actor);
+	if (target == NULL) {
+		return -2;
+	}
+
+	if (capacity == 0) {
+		capacity = tm->config.mailbox_capacity;
+	}
+
+	atomic_store(&target->mailbox.capacity, capacity);
+	atomic_store(&target->mailbox.policy, policy);
+
+	mailbox_wake_senders(&target->mailbox);
+
+	return 0;
+}
+
+
+int actor_mailbox_configure(actor_id_t actor, mailbox_policy_t policy, size_t capacity) {
+	return actor_system_mailbox_configure(tm_current(), actor, policy, capacity);
+}
+
+
+int actor_system_numa_node(actor_system_t *system, actor_id_t actor) {
+	thread_manager_t *tm = system;
+	if (tm == NULL) {
+		return -2;
+	}
+
+	actor_t *target = tm_actor_get(tm, actor);
+	if (target == NULL) {
+		return -2;
+	}
+
+	return (int)tm_actor_node(tm, target);
+}
+
+
+int actor_numa_node(actor_id_t actor) {
+	return actor_system_numa_node(tm_current(), actor);
+}
+
+
+uint64_t actor_histogram_bucket_nsec(size_t bucket) {
+	if (bucket < 8) {
+		return bucket;
+	}
+
+	return (uint64_t)(8 + bucket % 8) << (bucket / 8 - 1);
+}
+
+
+uint64_t actor_histogram_percentile(const actor_histogram_t *histogram, double fraction) {
+	uint64_t total = 0;
+	for (size_t i = 0; i < ACTOR_HISTOGRAM_BUCKETS; i++) {
+		total += histogram->buckets[i];
+	}
+	if (total == 0) {
+		return 0;
+	}
+
+	uint64_t rank = (uint64_t)(fraction * total + 0.5);
+	rank = rank < 1 ? 1 : rank > total ? total : rank;
+
+	uint64_t seen = 0;
+	for (size_t i = 0; i < ACTOR_HISTOGRAM_BUCKETS; i++) {
+		seen += histogram->buckets[i];
+		if (seen >= rank) {
+			return actor_histogram_bucket_nsec(i);
+		}
+	}
+
+	return actor_histogram_bucket_nsec(ACTOR_HISTOGRAM_BUCKETS - 1);
+}
+
+
+int actor_system_stats(actor_system_t *system, actor_stats_t *stats) {
+	memset(stats, 0, sizeof(*stats));
+
+#if CACTI_METRICS
+	thread_manager_t *tm = system;
+	if (tm == NULL) {
+		return -2;
+	}
+
+	stats->workers = calloc(tm->config.pool_size, sizeof(actor_worker_stats_t));
+	if (stats->workers == NULL) {
+		return -1;
+	}
+	stats->worker_count = tm->config.pool_size;
+
+	stats->actors = tm_live_actors(tm);
+	stats->ready = tm_ready_count(tm);
+
+	for (size_t i = 0; i < tm->config.pool_size; i++) {
+		worker_metrics_t *metrics = &tm->workers[i].metrics;
+		stats->workers[i].processed = atomic_load_explicit(&metrics->processed, memory_order_relaxed);
+		stats->workers[i].steals = atomic_load_explicit(&metrics->steals, memory_order_relaxed);
+		stats->workers[i].parks = atomic_load_explicit(&metrics->parks, memory_order_relaxed);
+		stats->workers[i].busy_nsec = atomic_load_explicit(&metrics->busy_nsec, memory_order_relaxed);
+		histogram_merge(&stats->queue_wait, &metrics->queue_wait);
+		histogram_merge(&stats->handler, &metrics->handler);
+	}
+
+	return 0;
+#else
+	(void)system;
+	return -6;
+#endif
+}
+
+
+void actor_stats_free(actor_stats_t *stats) {
+	free(stats->workers);
+	stats->workers = NULL;
+	stats->worker_count = 0;
+}
+
+
+int actor_system_actor_stats(actor_system_t *system, actor_id_t actor, actor_counters_t *counters) {
+	memset(counters, 0, sizeof(*counters));
+
+#if CACTI_METRICS
+	thread_manager_t *tm = system;
+	if (tm == NULL) {
+		return -2;
+	}
+
+	actor_t *target = tm_actor_get(tm, actor);
+	if (target == NULL) {
+		return -2;
+	}
+
+	counters->processed = atomic_load_explicit(&target->metrics.processed, memory_order_acquire);
+	counters->depth = mailbox_depth(&target->mailbox);
+	counters->max_depth = atomic_load_explicit(&target->metrics.max_depth, memory_order_relaxed);
+	counters->enqueued = counters->processed + counters->depth
+		+ atomic_load_explicit(&target->mailbox.dropped, memory_order_relaxed);
 
 	return 0;
+#else
+	(void)system; (void)actor;
+	return -6;
+#endif
 }
@@ -1,7 +1,9 @@
 #ifndef CACTI_H
 #define CACTI_H
 
+#include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 
 typedef long message_type_t;
 
@@ -21,6 +23,28 @@ typedef long message_type_t;
 #define POOL_SIZE 3
 #endif
 
+#ifndef MESSAGE_INLINE_SIZE
+#define MESSAGE_INLINE_SIZE 32
+#endif
+
+#ifndef ACTOR_BATCH_LIMIT
+#define ACTOR_BATCH_LIMIT 64
+#endif
+
+#ifndef ACTOR_BATCH_USEC
+#define ACTOR_BATCH_USEC 100
+#endif
+
+#ifndef ACTOR_TRACE_SAMPLE
+#define ACTOR_TRACE_SAMPLE 8
+#endif
+
+// Builds with CACTI_METRICS defined to 0 keep no counters at all and the
+// stats functions return -6.
+#ifndef CACTI_METRICS
+#define CACTI_METRICS 1
+#endif
+
 typedef struct message
 {
     message_type_t message_type;
@@ -30,8 +54,78 @@ typedef struct message
 
 typedef long actor_id_t;
 
+// An actor id is the index of the actor's slot tagged with the generation of
+// that slot. Generations only change when slots are recycled, so without
+// recycle_actors ids are plain indexes.
+#define ACTOR_INDEX_BITS 32
+#define ACTOR_ID_INDEX(id) ((id) & (((actor_id_t)1 << ACTOR_INDEX_BITS) - 1))
+#define ACTOR_ID_GENERATION(id) ((id) >> ACTOR_INDEX_BITS)
+
+typedef struct actor_system actor_system_t;
+
+// What send_message does when the recipient's mailbox is full. Workers never
+// block, so MAILBOX_BLOCK only applies to threads outside the pool and
+// send_message returns -3 from inside a prompt instead. Under
+// MAILBOX_DROP_OLDEST the send succeeds and discards the oldest message of
+// the lowest lane, even while the recipient is busy.
+typedef enum mailbox_policy
+{
+    MAILBOX_REJECT,
+    MAILBOX_BLOCK,
+    MAILBOX_DROP_OLDEST,
+    MAILBOX_GROW
+} mailbox_policy_t;
+
+// MESSAGE_HIGH messages are handled before any MESSAGE_NORMAL ones waiting in
+// the same mailbox, each priority in the order it was sent. MSG_SPAWN and
+// MSG_GODIE always go ahead of both and are never rejected by a full mailbox.
+typedef enum message_priority
+{
+    MESSAGE_NORMAL,
+    MESSAGE_HIGH
+} message_priority_t;
+
 actor_id_t actor_id_self();
 
+// The system whose worker is calling, NULL outside of prompts.
+actor_system_t *actor_system_self();
+
+// Zero fields take the defaults: one worker per online CPU, ACTOR_QUEUE_LIMIT
+// and MAILBOX_REJECT for new mailboxes, CAST_LIMIT actors, ACTOR_BATCH_LIMIT
+// messages or ACTOR_BATCH_USEC per dispatch (a negative batch_usec lifts the
+// time limit). With pin_workers set, worker i is pinned to the
+// (cpu_offset + i)-th CPU the process may run on and belongs to that CPU's
+// NUMA node; numa_nodes instead splits the workers evenly into that many
+// simulated nodes. Actors are allocated on the node of the worker that spawns
+// them, the node they first run on, and stay there: an actor's id is the
+// index of its slot, so it cannot move even if workers of another node end up
+// running it most. Mailbox nodes come from a pool shared by all nodes. Idle
+// workers steal within their node before crossing to another, which keeps
+// most actors running where they were allocated.
+// With recycle_actors set, the slot of an actor that is dead and drained is
+// reused by later spawns under a new generation, so cast_limit bounds the
+// actors alive at once and messages to the old id fail with -1. With
+// trace_path set, every prompt is traced and the trace is written to that
+// file when the system is waited for; the string has to stay valid until
+// then. Of the messages a thread sends, one in trace_sample (ACTOR_TRACE_SAMPLE
+// by default, 1 for all of them) is traced with its send and a flow to the
+// prompt that takes it.
+typedef struct actor_system_config
+{
+    size_t pool_size;
+    size_t mailbox_capacity;
+    mailbox_policy_t mailbox_policy;
+    size_t cast_limit;
+    size_t batch_limit;
+    long batch_usec;
+    bool pin_workers;
+    size_t cpu_offset;
+    size_t numa_nodes;
+    bool recycle_actors;
+    const char *trace_path;
+    size_t trace_sample;
+} actor_system_config_t;
+
 typedef void (*const act_t)(void **stateptr, size_t nbytes, void *data);
 
 typedef struct role
@@ -40,10 +134,194 @@ typedef struct role
     act_t *prompts;
 } role_t;
 
+// Functions that take no actor_system_t act on the system of the calling
+// worker, or on the one made by actor_system_create[_ex] when called from
+// any other thread.
 int actor_system_create(actor_id_t *actor, role_t *const role);
 
+int actor_system_create_ex(actor_id_t *actor, role_t *const role, const actor_system_config_t *config);
+
+// Returns once every actor is dead and its mailbox drained, or once a system
+// stopped by SIGINT has run the messages it already held. A stopped system
+// fails every later send with -1, those of its own prompts included.
 void actor_system_join(actor_id_t actor);
 
 int send_message(actor_id_t actor, message_t message);
 
+// Like send_message, but returns -3 on a full mailbox whatever its policy.
+int send_message_try(actor_id_t actor, message_t message);
+
+// Send the same message, data pointer included, to each of the actors, or to
+// every actor alive in the system. Return how many actors got it. Nothing
+// tracks a raw data pointer; payloads that have to be freed once every
+// recipient is done go through the _shared variants below.
+size_t send_message_multi(const actor_id_t *actors, size_t n, message_t message);
+
+size_t send_message_broadcast(message_t message);
+
+// Delayed and periodic delivery, with a resolution of one millisecond. The
+// message is sent after delay_usec and then every period_usec until the timer
+// is cancelled or the actor is gone; a full mailbox only skips that round.
+// Both return a timer id, or -1 when the actor does not exist.
+typedef long actor_timer_t;
+
+actor_timer_t send_message_after(actor_id_t actor, message_t message, long delay_usec);
+
+actor_timer_t send_message_every(actor_id_t actor, message_t message, long delay_usec, long period_usec);
+
+// Returns -1 when the timer has already fired for the last time.
+int actor_timer_cancel(actor_timer_t timer);
+
+int actor_mailbox_configure(actor_id_t actor, mailbox_policy_t policy, size_t capacity);
+
+// Request/reply. actor_ask sends the message together with a reply handle
+// and returns a future for the answer, or NULL when the send fails. The
+// prompt that gets the message finds the handle with actor_reply_handle and
+// has to answer it exactly once with actor_reply, then or later from any
+// thread. actor_future_wait blocks until the reply comes in and returns 0,
+// -1 when the message was dropped or went to MSG_SPAWN/MSG_GODIE, or -5 once
+// timeout_usec has passed since the ask (a negative timeout waits forever).
+// Like MAILBOX_BLOCK, waiting is meant for threads outside the pool.
+typedef struct actor_future actor_future_t;
+
+actor_future_t *actor_ask(actor_id_t actor, message_t message, long timeout_usec);
+
+int actor_future_wait(actor_future_t *future, message_t *reply);
+
+void actor_future_free(actor_future_t *future);
+
+actor_future_t *actor_reply_handle();
+
+int actor_reply(actor_future_t *handle, message_t reply);
+
+// Reference-counted payloads. A buffer starts with one reference, owned by
+// the caller. Each successful send_message_shared delivers the same bytes
+// (data = the buffer, nbytes = its size) and holds a reference until the
+// recipient's prompt returns, so the caller may release its own right after
+// sending. A released buffer goes back to a pool of the thread that allocated
+// it, to be reused by that thread's next allocations.
+void *message_buffer_alloc(size_t nbytes);
+
+void message_buffer_retain(void *buffer);
+
+void message_buffer_release(void *buffer);
+
+size_t message_buffer_size(void *buffer);
+
+int send_message_shared(actor_id_t actor, message_type_t type, void *buffer);
+
+// Multicast and broadcast of a buffer, with a reference for every actor that
+// gets it, so the buffer goes back once the last of them is done.
+size_t send_message_multi_shared(const actor_id_t *actors, size_t n, message_type_t type, void *buffer);
+
+size_t send_message_broadcast_shared(message_type_t type, void *buffer);
+
+// Copies up to MESSAGE_INLINE_SIZE bytes into the recipient's mailbox. The
+// prompt gets a pointer to that copy, valid until it returns, so small
+// payloads need no allocation on either side. Returns -4 when nbytes is
+// larger than MESSAGE_INLINE_SIZE.
+int send_message_inline(actor_id_t actor, message_type_t type, const void *bytes, size_t nbytes);
+
+int send_message_priority(actor_id_t actor, message_t message, message_priority_t priority);
+
+// The NUMA node the actor's memory was allocated for, -2 for no such actor.
+int actor_numa_node(actor_id_t actor);
+
+int actor_system_start(actor_system_t **system, actor_id_t *actor, role_t *const role, const actor_system_config_t *config);
+
+void actor_system_wait(actor_system_t *system, actor_id_t actor);
+
+int actor_system_send(actor_system_t *system, actor_id_t actor, message_t message);
+
+int actor_system_send_try(actor_system_t *system, actor_id_t actor, message_t message);
+
+int actor_system_send_shared(actor_system_t *system, actor_id_t actor, message_type_t type, void *buffer);
+
+int actor_system_send_inline(actor_system_t *system, actor_id_t actor, message_type_t type, const void *bytes, size_t nbytes);
+
+int actor_system_send_priority(actor_system_t *system, actor_id_t actor, message_t message, message_priority_t priority);
+
+actor_future_t *actor_system_ask(actor_system_t *system, actor_id_t actor, message_t message, long timeout_usec);
+
+size_t actor_system_send_multi(actor_system_t *system, const actor_id_t *actors, size_t n, message_t message);
+
+size_t actor_system_broadcast(actor_system_t *system, message_t message);
+
+size_t actor_system_send_multi_shared(actor_system_t *system, const actor_id_t *actors, size_t n, message_type_t type, void *buffer);
+
+size_t actor_system_broadcast_shared(actor_system_t *system, message_type_t type, void *buffer);
+
+actor_timer_t actor_system_send_after(actor_system_t *system, actor_id_t actor, message_t message, long delay_usec, long period_usec);
+
+int actor_system_timer_cancel(actor_system_t *system, actor_timer_t timer);
+
+int actor_system_mailbox_configure(actor_system_t *system, actor_id_t actor, mailbox_policy_t policy, size_t capacity);
+
+int actor_system_numa_node(actor_system_t *system, actor_id_t actor);
+
+// Log-linear histogram of nanoseconds: values below 8 have a bucket each, and
+// every power of two above is split into 8 buckets, so a bucket's bounds are
+// within 12.5% of each other. The last bucket also takes everything larger.
+#define ACTOR_HISTOGRAM_BUCKETS 320
+
+typedef struct actor_histogram
+{
+    uint64_t count;
+    uint64_t max_nsec;
+    uint64_t buckets[ACTOR_HISTOGRAM_BUCKETS];
+} actor_histogram_t;
+
+// The smallest value that falls into the bucket.
+uint64_t actor_histogram_bucket_nsec(size_t bucket);
+
+// The lower bound of the bucket holding the given fraction of the values,
+// 0 for an empty histogram.
+uint64_t actor_histogram_percentile(const actor_histogram_t *histogram, double fraction);
+
+typedef struct actor_worker_stats
+{
+    uint64_t processed;
+    uint64_t steals;
+    uint64_t parks;
+    uint64_t busy_nsec;
+} actor_worker_stats_t;
+
+// queue_wait runs from the send to the start of the prompt, handler covers
+// the prompt itself; both are summed over all workers and sample one in 16
+// of the messages each thread sends.
+typedef struct actor_stats
+{
+    size_t actors;
+    size_t ready;
+    size_t worker_count;
+    actor_worker_stats_t *workers;
+    actor_histogram_t queue_wait;
+    actor_histogram_t handler;
+} actor_stats_t;
+
+// depth counts the messages waiting now, max_depth the most seen waiting
+// when a prompt was about to start. enqueued includes messages dropped by
+// MAILBOX_DROP_OLDEST.
+typedef struct actor_counters
+{
+    uint64_t enqueued;
+    uint64_t processed;
+    size_t depth;
+    size_t max_depth;
+} actor_counters_t;
+
+// Fills a snapshot of counters that keep moving while it is taken, so totals
+// may disagree slightly. The workers array is allocated for the caller, who
+// releases it with actor_stats_free.
+int actor_system_stats(actor_system_t *system, actor_stats_t *stats);
+
+void actor_stats_free(actor_stats_t *stats);
+
+int actor_system_actor_stats(actor_system_t *system, actor_id_t actor, actor_counters_t *counters);
+
+// Writes what the threads of a traced system still keep of their last
+// events to path, in the Chrome trace event format Perfetto also reads.
+// Returns -1 when the system is not traced or the file cannot be written.
+int actor_system_trace_dump(actor_system_t *system, const char *path);
+
 #endif
@@ -1,3 +1,4 @@
+#include <cstdio>
 #include <cstdlib>
 #include <atomic>
 #include <random>
@@ -17,6 +18,7 @@ static std::atomic_long max_actor_id;
 static thread_local std::mt19937 t_random = init_random();
 static std::atomic_long rx_msgs;
 static int rx_one_times = 0;
+static std::atomic_bool in_prompt[CAST_LIMIT];
 
 static void do_chaos(void**, size_t, void*);
 
@@ -25,11 +27,15 @@ static role_t r1 = {1, f1};
 
 static void do_chaos(void**, size_t, void*) {
     // printf("[%li] do_chaos: %li\n", actor_id_self(), rx_msgs.load());
+    if (in_prompt[actor_id_self()].exchange(true)) {
+        fprintf(stderr, "actor %li runs on two workers at once\n", actor_id_self());
+        abort();
+    }
+
     if (actor_id_self() == 0) {
         if (++rx_one_times == 1000) {
             // (try to) kill all actors
-            for (int i = 0; i <= max_actor_id; i++)
-                send_message(i, {MSG_GODIE, 0, NULL});
+            send_message_broadcast({MSG_GODIE, 0, NULL});
             rx_one_times = 0;
         }
         rx_msgs = 0;
@@ -55,6 +61,8 @@ static void do_chaos(void**, size_t, void*) {
     }
 
     send_message(actor_id_self(), {MSG_HELLO, 0, &r1});
+
+    in_prompt[actor_id_self()] = false;
 }
 
 
@@ -1,5 +1,316 @@
 #include "cacti.h"
 
-int main() {
+#include <fcntl.h>
+#include <semaphore.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MSG_JOIN 1
+#define MSG_ROW 2
+#define MSG_CELL 1
+
+// Rows read ahead of the first one not yet printed. It bounds the memory
+// held whatever the size of the matrix, and keeps every mailbox well below
+// its capacity.
+#define ROW_WINDOW 256
+
+// Sums the rows of a k x n matrix given as k and n followed by k * n pairs
+// "value milliseconds", row by row. Each column has an actor that takes a
+// cell that many milliseconds to add to the row's sum and passes the row on
+// to the next column, so up to n rows are in the pipeline at once. The sums
+// are printed in row order and the throughput goes to stderr.
+//
+// macierz [file|-] [workers]
+
+typedef struct cell
+{
+	long value;
+	long time_ms;
+} cell_t;
+
+typedef struct row
+{
+	size_t index;
+	size_t column;
+	long sum;
+	cell_t cells[];
+} row_t;
+
+typedef struct reader
+{
+	const char *map;
+	size_t size;
+	const char *at;
+	const char *end;
+	FILE *file;
+} reader_t;
+
+static size_t rows;
+static size_t columns;
+static actor_id_t collector;
+static actor_id_t *column_actors;
+static size_t joined;
+static row_t *window[ROW_WINDOW];
+static size_t printed;
+static sem_t ready;
+static sem_t window_free;
+
+static void collector_hello(void **stateptr, size_t nbytes, void *data);
+static void collector_join(void **stateptr, size_t nbytes, void *data);
+static void collector_row(void **stateptr, size_t nbytes, void *data);
+static void column_hello(void **stateptr, size_t nbytes, void *data);
+static void column_cell(void **stateptr, size_t nbytes, void *data);
+
+static act_t collector_acts[3] = {collector_hello, collector_join, collector_row};
+static role_t collector_role = {3, collector_acts};
+
+static act_t column_acts[2] = {column_hello, column_cell};
+static role_t column_role = {2, column_acts};
+
+static void finish() {
+	for (size_t i = 0; i < columns; i++) {
+		send_message(column_actors[i], (message_t){MSG_GODIE, 0, NULL});
+	}
+	send_message(actor_id_self(), (message_t){MSG_GODIE, 0, NULL});
+}
+
+static void collector_hello(void **stateptr, size_t nbytes, void *data) {
+	(void)stateptr; (void)nbytes; (void)data;
+
+	for (size_t i = 0; i < columns; i++) {
+		send_message(actor_id_self(), (message_t){MSG_SPAWN, 0, &column_role});
+	}
+	if (columns == 0) {
+		for (size_t i = 0; i < rows; i++) {
+			printf("0\n");
+		}
+		sem_post(&ready);
+		finish();
+	}
+}
+
+// Columns take their place in the pipeline in the order they report in.
+static void collector_join(void **stateptr, size_t nbytes, void *data) {
+	(void)stateptr; (void)nbytes;
+
+	column_actors[joined++] = (actor_id_t)data;
+	if (joined == columns) {
+		sem_post(&ready);
+		if (rows == 0) {
+			finish();
+		}
+	}
+}
+
+static void collector_row(void **stateptr, size_t nbytes, void *data) {
+	(void)stateptr; (void)nbytes;
+
+	row_t *row = data;
+	window[row->index % ROW_WINDOW] = row;
+
+	while (printed < rows && (row = window[printed % ROW_WINDOW]) != NULL && row->index == printed) {
+		printf("%ld\n", row->sum);
+		window[printed % ROW_WINDOW] = NULL;
+		free(row);
+		printed++;
+		sem_post(&window_free);
+	}
+
+	if (printed == rows) {
+		finish();
+	}
+}
+
+static void column_hello(void **stateptr, size_t nbytes, void *data) {
+	(void)stateptr; (void)nbytes;
+
+	send_message((actor_id_t)data, (message_t){MSG_JOIN, 0, (void *)actor_id_self()});
+}
+
+static void column_cell(void **stateptr, size_t nbytes, void *data) {
+	(void)stateptr; (void)nbytes;
+
+	row_t *row = data;
+	cell_t *cell = &row->cells[row->column];
+	if (cell->time_ms > 0) {
+		usleep(cell->time_ms * 1000);
+	}
+	row->sum += cell->value;
+
+	if (++row->column < columns) {
+		send_message(column_actors[row->column], (message_t){MSG_CELL, 0, row});
+	} else {
+		send_message(collector, (message_t){MSG_ROW, 0, row});
+	}
+}
+
+static int reader_next(reader_t *reader) {
+	if (reader->file != NULL) {
+		return getc_unlocked(reader->file);
+	}
+
+	return reader->at < reader->end ? (unsigned char)*reader->at++ : EOF;
+}
+
+static bool read_long(reader_t *reader, long *value) {
+	int c = reader_next(reader);
+	while (c == ' ' || c == '\n' || c == '\t' || c == '\r') {
+		c = reader_next(reader);
+	}
+
+	bool negative = c == '-';
+	if (negative) {
+		c = reader_next(reader);
+	}
+	if (c < '0' || c > '9') {
+		return false;
+	}
+
+	long result = 0;
+	for (; c >= '0' && c <= '9'; c = reader_next(reader)) {
+		result = result * 10 + (c - '0');
+	}
+	*value = negative ? -result : result;
+
+	return true;
+}
+
+// Regular files are mapped and read front to back, so the kernel can drop
+// pages behind the cursor; anything else is read as a stream.
+static int reader_open(reader_t *reader, const char *path) {
+	reader->map = NULL;
+	reader->size = 0;
+	reader->at = NULL;
+	reader->end = NULL;
+	reader->file = stdin;
+	if (path == NULL || (path[0] == '-' && path[1] == '\0')) {
+		return 0;
+	}
+
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		return -1;
+	}
+
+	struct stat st;
+	if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+		void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (map != MAP_FAILED) {
+			madvise(map, st.st_size, MADV_SEQUENTIAL);
+			reader->map = map;
+			reader->size = st.st_size;
+			reader->at = map;
+			reader->end = reader->at + st.st_size;
+			reader->file = NULL;
+			close(fd);
+			return 0;
+		}
+	}
+
+	reader->file = fdopen(fd, "r");
+	if (reader->file == NULL) {
+		close(fd);
+		return -1;
+	}
+
+	return 0;
+}
+
+static void reader_close(reader_t *reader) {
+	if (reader->file == NULL) {
+		munmap((void *)reader->map, reader->size);
+	} else if (reader->file != stdin) {
+		fclose(reader->file);
+	}
+}
+
+static row_t *read_row(reader_t *reader, size_t index) {
+	row_t *row = malloc(sizeof(row_t) + columns * sizeof(cell_t));
+	if (row == NULL) {
+		return NULL;
+	}
+
+	row->index = index;
+	row->column = 0;
+	row->sum = 0;
+	for (size_t i = 0; i < columns; i++) {
+		if (!read_long(reader, &row->cells[i].value) || !read_long(reader, &row->cells[i].time_ms)
+			|| row->cells[i].time_ms < 0) {
+			free(row);
+			return NULL;
+		}
+	}
+
+	return row;
+}
+
+int main(int argc, char **argv) {
+	reader_t reader;
+	if (reader_open(&reader, argc > 1 ? argv[1] : NULL) != 0) {
+		perror(argv[1]);
+		return 1;
+	}
+
+	long k;
+	long n;
+	if (!read_long(&reader, &k) || !read_long(&reader, &n) || k < 0 || n < 0) {
+		fprintf(stderr, "macierz: expected the number of rows and columns\n");
+		return 1;
+	}
+	rows = k;
+	columns = n;
+
+	column_actors = calloc(columns + 1, sizeof(actor_id_t));
+	if (column_actors == NULL) {
+		return 1;
+	}
+	sem_init(&ready, 0, 0);
+	sem_init(&window_free, 0, ROW_WINDOW);
+
+	actor_system_config_t config = {0};
+	config.pool_size = argc > 2 ? strtoul(argv[2], NULL, 10) : POOL_SIZE;
+	config.cast_limit = columns + 1;
+
+	struct timespec start;
+	struct timespec end;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	actor_system_t *system;
+	if (actor_system_start(&system, &collector, &collector_role, &config) != 0) {
+		return 1;
+	}
+	sem_wait(&ready);
+
+	int result = 0;
+	for (size_t i = 0; i < rows && columns > 0; i++) {
+		sem_wait(&window_free);
+
+		row_t *row = read_row(&reader, i);
+		if (row == NULL || actor_system_send(system, column_actors[0], (message_t){MSG_CELL, 0, row}) != 0) {
+			fprintf(stderr, "macierz: row %zu is incomplete\n", i);
+			free(row);
+			result = 1;
+			break;
+		}
+	}
+
+	if (result != 0) {
+		fflush(stdout);
+		_exit(result);
+	}
+	actor_system_wait(system, collector);
+	reader_close(&reader);
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+	fprintf(stderr, "macierz workers=%zu rows=%zu columns=%zu seconds=%.3f rows_per_sec=%.1f cells_per_sec=%.1f\n",
+		config.pool_size, rows, columns, seconds, rows / seconds, rows * columns / seconds);
+
+	free(column_actors);
+
 	return 0;
 }
@@ -1,5 +1,437 @@
 #include "cacti.h"
 
-int main() {
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define MSG_JOIN 1
+#define MSG_PARTIAL 2
+#define MSG_RANGE 2
+#define MSG_RESULT 3
+
+#define LIMB_BASE 1000000000U
+#define LIMB_DIGITS 9
+
+// Products of two numbers at least this many limbs long are split in three
+// smaller ones (Karatsuba); below it schoolbook multiplication is faster.
+#define KARATSUBA_LIMBS 32
+
+// Ranges of at most this many factors are multiplied out by a single actor.
+#define TREE_LEAF 256
+
+// Computes n! for n given as the first argument or on stdin, in one of two
+// ways. In chain mode actor k multiplies the partial product by k and hands
+// it to actor k + 1, which it spawns, so the work is strictly sequential and
+// the chain is as long as n. In tree mode each actor splits its range of
+// factors between two children and multiplies their results, so all workers
+// share the large multiplications. Partial products are moved from actor to
+// actor with their limbs, never copied. The time taken goes to stderr.
+//
+// silnia [n|-] [chain|tree] [workers]
+
+// Little-endian limbs in base LIMB_BASE, so printing needs no conversion.
+typedef struct bigint
+{
+	size_t length;
+	size_t capacity;
+	uint32_t limbs[];
+} bigint_t;
+
+typedef struct partial
+{
+	uint64_t factor;
+	bigint_t *product;
+} partial_t;
+
+typedef struct range
+{
+	uint64_t low;
+	uint64_t high;
+} range_t;
+
+typedef struct node
+{
+	actor_id_t parent;
+	range_t range;
+	size_t joined;
+	size_t pending;
+	bigint_t *product;
+} node_t;
+
+static uint64_t n;
+static bigint_t *result;
+
+static bigint_t *bigint_new(size_t capacity, uint32_t value) {
+	bigint_t *bigint = malloc(sizeof(bigint_t) + capacity * sizeof(uint32_t));
+	if (bigint == NULL) {
+		abort();
+	}
+
+	bigint->length = 1;
+	bigint->capacity = capacity;
+	bigint->limbs[0] = value;
+
+	return bigint;
+}
+
+// The factor has to be below 2^64 / LIMB_BASE for the carry to fit.
+static bigint_t *bigint_mul_small(bigint_t *bigint, uint64_t factor) {
+	uint64_t carry = 0;
+	for (size_t i = 0; i < bigint->length; i++) {
+		uint64_t limb = bigint->limbs[i] * factor + carry;
+		bigint->limbs[i] = limb % LIMB_BASE;
+		carry = limb / LIMB_BASE;
+	}
+
+	while (carry != 0) {
+		if (bigint->length == bigint->capacity) {
+			bigint->capacity *= 2;
+			bigint = realloc(bigint, sizeof(bigint_t) + bigint->capacity * sizeof(uint32_t));
+			if (bigint == NULL) {
+				abort();
+			}
+		}
+		bigint->limbs[bigint->length++] = carry % LIMB_BASE;
+		carry /= LIMB_BASE;
+	}
+
+	return bigint;
+}
+
+// x += y, where x is long enough to take the carry.
+static void limbs_add(uint32_t *x, size_t x_length, const uint32_t *y, size_t y_length) {
+	uint32_t carry = 0;
+	for (size_t i = 0; i < x_length && (i < y_length || carry != 0); i++) {
+		uint32_t limb = x[i] + (i < y_length ? y[i] : 0) + carry;
+		carry = limb >= LIMB_BASE;
+		x[i] = carry ? limb - LIMB_BASE : limb;
+	}
+}
+
+// x -= y, where x is not smaller than y.
+static void limbs_sub(uint32_t *x, size_t x_length, const uint32_t *y, size_t y_length) {
+	uint32_t borrow = 0;
+	for (size_t i = 0; i < x_length && (i < y_length || borrow != 0); i++) {
+		uint32_t subtrahend = (i < y_length ? y[i] : 0) + borrow;
+		borrow = x[i] < subtrahend;
+		x[i] = borrow ? x[i] + LIMB_BASE - subtrahend : x[i] - subtrahend;
+	}
+}
+
+// r = x * y, where r has room for x_length + y_length limbs.
+static void limbs_mul(uint32_t *r, const uint32_t *x, size_t x_length, const uint32_t *y, size_t y_length) {
+	memset(r, 0, (x_length + y_length) * sizeof(uint32_t));
+
+	if (x_length < y_length) {
+		const uint32_t *swap = x;
+		x = y;
+		y = swap;
+		size_t swap_length = x_length;
+		x_length = y_length;
+		y_length = swap_length;
+	}
+
+	if (y_length < KARATSUBA_LIMBS) {
+		for (size_t i = 0; i < y_length; i++) {
+			uint64_t carry = 0;
+			for (size_t j = 0; j < x_length; j++) {
+				uint64_t limb = r[i + j] + (uint64_t)y[i] * x[j] + carry;
+				r[i + j] = limb % LIMB_BASE;
+				carry = limb / LIMB_BASE;
+			}
+			r[i + x_length] = carry;
+		}
+		return;
+	}
+
+	size_t half = (x_length + 1) / 2;
+	uint32_t *scratch;
+
+	// Far apart lengths are multiplied a y-sized slice of x at a time.
+	if (y_length <= half) {
+		scratch = malloc((2 * y_length) * sizeof(uint32_t));
+		if (scratch == NULL) {
+			abort();
+		}
+		for (size_t at = 0; at < x_length; at += y_length) {
+			size_t slice = x_length - at < y_length ? x_length - at : y_length;
+			limbs_mul(scratch, x + at, slice, y, y_length);
+			limbs_add(r + at, x_length + y_length - at, scratch, slice + y_length);
+		}
+		free(scratch);
+		return;
+	}
+
+	// x = x0 + x1 B^half, y = y0 + y1 B^half, and
+	// x y = x0 y0 + ((x0 + x1)(y0 + y1) - x0 y0 - x1 y1) B^half + x1 y1 B^2half.
+	size_t x1_length = x_length - half;
+	size_t y1_length = y_length - half;
+	size_t sum_length = half + 1;
+
+	scratch = calloc(4 * sum_length, sizeof(uint32_t));
+	if (scratch == NULL) {
+		abort();
+	}
+	uint32_t *x_sum = scratch;
+	uint32_t *y_sum = x_sum + sum_length;
+	uint32_t *middle = y_sum + sum_length;
+
+	memcpy(x_sum, x, half * sizeof(uint32_t));
+	limbs_add(x_sum, sum_length, x + half, x1_length);
+	memcpy(y_sum, y, half * sizeof(uint32_t));
+	limbs_add(y_sum, sum_length, y + half, y1_length);
+
+	limbs_mul(r, x, half, y, half);
+	limbs_mul(r + 2 * half, x + half, x1_length, y + half, y1_length);
+	limbs_mul(middle, x_sum, sum_length, y_sum, sum_length);
+
+	limbs_sub(middle, 2 * sum_length, r, 2 * half);
+	limbs_sub(middle, 2 * sum_length, r + 2 * half, x1_length + y1_length);
+	limbs_add(r + half, x_length + y_length - half, middle, 2 * sum_length);
+
+	free(scratch);
+}
+
+static bigint_t *bigint_mul(const bigint_t *x, const bigint_t *y) {
+	size_t length = x->length + y->length;
+	bigint_t *product = bigint_new(length, 0);
+
+	limbs_mul(product->limbs, x->limbs, x->length, y->limbs, y->length);
+	while (length > 1 && product->limbs[length - 1] == 0) {
+		length--;
+	}
+	product->length = length;
+
+	return product;
+}
+
+static void bigint_print(const bigint_t *bigint) {
+	printf("%" PRIu32, bigint->limbs[bigint->length - 1]);
+	for (size_t i = bigint->length - 1; i-- > 0;) {
+		printf("%0*" PRIu32, LIMB_DIGITS, bigint->limbs[i]);
+	}
+	printf("\n");
+}
+
+// Several factors are packed into one pass over the limbs.
+static bigint_t *range_product(range_t range) {
+	bigint_t *product = bigint_new(16, 1);
+
+	uint64_t packed = 1;
+	for (uint64_t factor = range.low; factor <= range.high; factor++) {
+		if (packed > LIMB_BASE / factor) {
+			product = bigint_mul_small(product, packed);
+			packed = 1;
+		}
+		packed *= factor;
+	}
+
+	return bigint_mul_small(product, packed);
+}
+
+static void die(void **stateptr) {
+	free(*stateptr);
+	*stateptr = NULL;
+	send_message(actor_id_self(), (message_t){MSG_GODIE, 0, NULL});
+}
+
+static void chain_hello(void **stateptr, size_t nbytes, void *data);
+static void chain_root_hello(void **stateptr, size_t nbytes, void *data);
+static void chain_join(void **stateptr, size_t nbytes, void *data);
+static void chain_partial(void **stateptr, size_t nbytes, void *data);
+
+static act_t chain_acts[3] = {chain_hello, chain_join, chain_partial};
+static role_t chain_role = {3, chain_acts};
+
+static act_t chain_root_acts[3] = {chain_root_hello, chain_join, chain_partial};
+static role_t chain_root_role = {3, chain_root_acts};
+
+static void chain_hello(void **stateptr, size_t nbytes, void *data) {
+	(void)stateptr; (void)nbytes;
+
+	send_message((actor_id_t)data, (message_t){MSG_JOIN, 0, (void *)actor_id_self()});
+}
+
+static void chain_root_hello(void **stateptr, size_t nbytes, void *data) {
+	(void)nbytes; (void)data;
+
+	partial_t partial = {1, bigint_new(16, 1)};
+	chain_partial(stateptr, sizeof(partial), &partial);
+}
+
+// The partial product waits in the state until the next actor reports in.
+static void chain_join(void **stateptr, size_t nbytes, void *data) {
+	(void)nbytes;
+
+	partial_t *partial = *stateptr;
+	send_message_inline((actor_id_t)data, MSG_PARTIAL, partial, sizeof(partial_t));
+	die(stateptr);
+}
+
+static void chain_partial(void **stateptr, size_t nbytes, void *data) {
+	(void)nbytes;
+
+	partial_t *partial = malloc(sizeof(partial_t));
+	if (partial == NULL) {
+		abort();
+	}
+	*partial = *(partial_t *)data;
+	*stateptr = partial;
+
+	if (partial->factor > 1) {
+		partial->product = bigint_mul_small(partial->product, partial->factor);
+	}
+	if (partial->factor >= n) {
+		result = partial->product;
+		die(stateptr);
+		return;
+	}
+
+	partial->factor++;
+	send_message(actor_id_self(), (message_t){MSG_SPAWN, 0, &chain_role});
+}
+
+static void tree_hello(void **stateptr, size_t nbytes, void *data);
+static void tree_root_hello(void **stateptr, size_t nbytes, void *data);
+static void tree_join(void **stateptr, size_t nbytes, void *data);
+static void tree_range(void **stateptr, size_t nbytes, void *data);
+static void tree_result(void **stateptr, size_t nbytes, void *data);
+
+static act_t tree_acts[4] = {tree_hello, tree_join, tree_range, tree_result};
+static role_t tree_role = {4, tree_acts};
+
+static act_t tree_root_acts[4] = {tree_root_hello, tree_join, tree_range, tree_result};
+static role_t tree_root_role = {4, tree_root_acts};
+
+static node_t *node_new(void **stateptr, actor_id_t parent) {
+	node_t *node = calloc(1, sizeof(node_t));
+	if (node == NULL) {
+		abort();
+	}
+	node->parent = parent;
+	*stateptr = node;
+
+	return node;
+}
+
+static void tree_deliver(void **stateptr, bigint_t *product) {
+	node_t *node = *stateptr;
+
+	if (node->parent == -1) {
+		result = product;
+	} else {
+		send_message(node->parent, (message_t){MSG_RESULT, 0, product});
+	}
+	die(stateptr);
+}
+
+static void tree_hello(void **stateptr, size_t nbytes, void *data) {
+	(void)nbytes;
+
+	node_new(stateptr, (actor_id_t)data);
+	send_message((actor_id_t)data, (message_t){MSG_JOIN, 0, (void *)actor_id_self()});
+}
+
+static void tree_root_hello(void **stateptr, size_t nbytes, void *data) {
+	(void)nbytes; (void)data;
+
+	node_new(stateptr, -1);
+
+	range_t range = {1, n};
+	tree_range(stateptr, sizeof(range), &range);
+}
+
+static void tree_range(void **stateptr, size_t nbytes, void *data) {
+	(void)nbytes;
+
+	node_t *node = *stateptr;
+	node->range = *(range_t *)data;
+	if (node->range.high < node->range.low + TREE_LEAF) {
+		tree_deliver(stateptr, range_product(node->range));
+		return;
+	}
+
+	node->pending = 2;
+	send_message(actor_id_self(), (message_t){MSG_SPAWN, 0, &tree_role});
+	send_message(actor_id_self(), (message_t){MSG_SPAWN, 0, &tree_role});
+}
+
+// The first child to report in gets the lower half of the range.
+static void tree_join(void **stateptr, size_t nbytes, void *data) {
+	(void)nbytes;
+
+	node_t *node = *stateptr;
+	uint64_t middle = node->range.low + (node->range.high - node->range.low) / 2;
+	range_t half = node->joined++ == 0
+		? (range_t){node->range.low, middle}
+		: (range_t){middle + 1, node->range.high};
+
+	send_message_inline((actor_id_t)data, MSG_RANGE, &half, sizeof(half));
+}
+
+static void tree_result(void **stateptr, size_t nbytes, void *data) {
+	(void)nbytes;
+
+	node_t *node = *stateptr;
+	bigint_t *product = data;
+	if (node->product != NULL) {
+		bigint_t *both = bigint_mul(node->product, product);
+		free(node->product);
+		free(product);
+		product = both;
+	}
+	node->product = product;
+
+	if (--node->pending == 0) {
+		tree_deliver(stateptr, node->product);
+	}
+}
+
+int main(int argc, char **argv) {
+	if (argc > 1 && strcmp(argv[1], "-") != 0) {
+		n = strtoull(argv[1], NULL, 10);
+	} else if (scanf("%" SCNu64, &n) != 1) {
+		fprintf(stderr, "silnia: expected n\n");
+		return 1;
+	}
+
+	const char *mode = argc > 2 ? argv[2] : "tree";
+	bool chain = strcmp(mode, "chain") == 0;
+	if (!chain && strcmp(mode, "tree") != 0) {
+		fprintf(stderr, "silnia: unknown mode %s\n", mode);
+		return 1;
+	}
+
+	actor_system_config_t config = {0};
+	config.pool_size = argc > 3 ? strtoul(argv[3], NULL, 10) : POOL_SIZE;
+	config.recycle_actors = true;
+
+	struct timespec start;
+	struct timespec end;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	actor_system_t *system;
+	actor_id_t root;
+	if (actor_system_start(&system, &root, chain ? &chain_root_role : &tree_root_role, &config) != 0) {
+		return 1;
+	}
+	actor_system_wait(system, root);
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	if (result == NULL) {
+		return 1;
+	}
+	bigint_print(result);
+
+	int top_digits = snprintf(NULL, 0, "%" PRIu32, result->limbs[result->length - 1]);
+	size_t digits = (result->length - 1) * LIMB_DIGITS + top_digits;
+	double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+	fprintf(stderr, "silnia mode=%s workers=%zu n=%" PRIu64 " digits=%zu seconds=%.3f\n",
+		mode, config.pool_size, n, digits, seconds);
+
+	free(result);
+
 	return 0;
 }
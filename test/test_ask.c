@@ -0,0 +1,106 @@
+#include "minunit.h"
+#include "cacti.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+
+#define MSG_DOUBLE 1
+#define MSG_HOLD 2
+#define MSG_ANSWER_HELD 3
+
+int tests_run = 0;
+
+static actor_future_t *held;
+
+static void hello(void **stateptr, size_t nbytes, void *data);
+static void double_it(void **stateptr, size_t nbytes, void *data);
+static void hold(void **stateptr, size_t nbytes, void *data);
+static void answer_held(void **stateptr, size_t nbytes, void *data);
+
+static act_t acts[4] = {hello, double_it, hold, answer_held};
+static role_t role = {4, acts};
+
+static void hello(void **stateptr, size_t nbytes, void *data)
+{
+	(void)stateptr; (void)nbytes; (void)data;
+}
+
+static void double_it(void **stateptr, size_t nbytes, void *data)
+{
+	(void)stateptr; (void)nbytes;
+
+	actor_reply(actor_reply_handle(), (message_t){0, 0, (void *)(2 * (long)data)});
+}
+
+static void hold(void **stateptr, size_t nbytes, void *data)
+{
+	(void)stateptr; (void)nbytes; (void)data;
+
+	held = actor_reply_handle();
+}
+
+static void answer_held(void **stateptr, size_t nbytes, void *data)
+{
+	(void)stateptr; (void)nbytes; (void)data;
+
+	actor_reply(held, (message_t){0, 0, NULL});
+	actor_reply(actor_reply_handle(), (message_t){0, 0, NULL});
+}
+
+static int ask(actor_id_t actor, message_type_t type, long data, long timeout_usec, long *answer)
+{
+	actor_future_t *future = actor_ask(actor, (message_t){type, 0, (void *)data}, timeout_usec);
+	if (future == NULL) {
+		return -2;
+	}
+
+	message_t reply;
+	int status = actor_future_wait(future, &reply);
+	actor_future_free(future);
+
+	if (status == 0 && answer != NULL) {
+		*answer = (long)reply.data;
+	}
+	return status;
+}
+
+static char *ask_and_reply()
+{
+	actor_id_t actor;
+	mu_assert("create failed", actor_system_create(&actor, &role) == 0);
+
+	long answer = 0;
+	mu_assert("ask failed", ask(actor, MSG_DOUBLE, 21, -1, &answer) == 0);
+	mu_assert("wrong answer", answer == 42);
+
+	mu_assert("no timeout", ask(actor, MSG_HOLD, 0, 10000, NULL) == -5);
+	mu_assert("late answer failed", ask(actor, MSG_ANSWER_HELD, 0, -1, NULL) == 0);
+
+	mu_assert("godie answered", ask(actor, MSG_GODIE, 0, -1, NULL) == -1);
+	mu_assert("dead actor asked", ask(actor, MSG_DOUBLE, 1, -1, NULL) == -2);
+
+	actor_system_join(actor);
+	return 0;
+}
+
+static char *all_tests()
+{
+	mu_run_test(ask_and_reply);
+	return 0;
+}
+
+int main()
+{
+	char *result = all_tests();
+	if (result != 0)
+	{
+		printf(__FILE__ ": %s\n", result);
+	}
+	else
+	{
+		printf(__FILE__ ": ALL TESTS PASSED\n");
+	}
+	printf(__FILE__ ": Tests run: %d\n", tests_run);
+
+	return result != 0;
+}
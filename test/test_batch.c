@@ -0,0 +1,95 @@
+#include "minunit.h"
+#include "cacti.h"
+
+#include <stdatomic.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#define MSG_SLOW 1
+#define SLOW_MESSAGES 10
+#define SLOW_USEC 2000
+
+int tests_run = 0;
+
+static atomic_int slow_done;
+static int slow_done_seen = -1;
+
+static void slow_hello(void **stateptr, size_t nbytes, void *data);
+static void slow_work(void **stateptr, size_t nbytes, void *data);
+static void other_hello(void **stateptr, size_t nbytes, void *data);
+
+static act_t slow_acts[2] = {slow_hello, slow_work};
+static role_t slow_role = {2, slow_acts};
+
+static act_t other_acts[1] = {other_hello};
+static role_t other_role = {1, other_acts};
+
+// The spawn overtakes the slow messages in the system lane, so the other
+// actor is queued behind this one before the first of them runs.
+static void slow_hello(void **stateptr, size_t nbytes, void *data)
+{
+	(void)stateptr; (void)nbytes; (void)data;
+
+	actor_id_t self = actor_id_self();
+	for (int i = 0; i < SLOW_MESSAGES; i++) {
+		send_message(self, (message_t){MSG_SLOW, 0, NULL});
+	}
+	send_message(self, (message_t){MSG_SPAWN, 0, &other_role});
+	send_message(self, (message_t){MSG_GODIE, 0, NULL});
+}
+
+static void slow_work(void **stateptr, size_t nbytes, void *data)
+{
+	(void)stateptr; (void)nbytes; (void)data;
+
+	usleep(SLOW_USEC);
+	atomic_fetch_add(&slow_done, 1);
+}
+
+static void other_hello(void **stateptr, size_t nbytes, void *data)
+{
+	(void)stateptr; (void)nbytes; (void)data;
+
+	slow_done_seen = atomic_load(&slow_done);
+	send_message(actor_id_self(), (message_t){MSG_GODIE, 0, NULL});
+}
+
+// Each slow prompt takes 20 times the quantum, so the batch has to end after
+// the first one and let the other actor run.
+static char *slow_prompts_yield()
+{
+	actor_system_config_t config = {0};
+	config.pool_size = 1;
+	config.batch_usec = 100;
+
+	actor_id_t root;
+	mu_assert("create failed", actor_system_create_ex(&root, &slow_role, &config) == 0);
+	actor_system_join(root);
+
+	mu_assert("slow messages lost", atomic_load(&slow_done) == SLOW_MESSAGES);
+	mu_assert("other actor never ran", slow_done_seen >= 0);
+	mu_assert("batch ran past its quantum", slow_done_seen <= 1);
+	return 0;
+}
+
+static char *all_tests()
+{
+	mu_run_test(slow_prompts_yield);
+	return 0;
+}
+
+int main()
+{
+	char *result = all_tests();
+	if (result != 0)
+	{
+		printf(__FILE__ ": %s\n", result);
+	}
+	else
+	{
+		printf(__FILE__ ": ALL TESTS PASSED\n");
+	}
+	printf(__FILE__ ": Tests run: %d\n", tests_run);
+
+	return result != 0;
+}
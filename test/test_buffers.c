@@ -0,0 +1,162 @@
+#include "minunit.h"
+#include "cacti.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#define MSG_READY 1
+#define MSG_PAYLOAD 1
+#define CHILDREN 8
+#define PAYLOAD (4 << 20)
+
+int tests_run = 0;
+
+static actor_id_t children[CHILDREN];
+static size_t ready;
+static void *sent;
+static void *received[CHILDREN];
+static size_t received_count;
+static bool intact = true;
+
+static void root_hello(void **stateptr, size_t nbytes, void *data);
+static void root_ready(void **stateptr, size_t nbytes, void *data);
+static void child_hello(void **stateptr, size_t nbytes, void *data);
+static void child_payload(void **stateptr, size_t nbytes, void *data);
+
+static act_t root_acts[2] = {root_hello, root_ready};
+static role_t root_role = {2, root_acts};
+
+static act_t child_acts[2] = {child_hello, child_payload};
+static role_t child_role = {2, child_acts};
+
+static void *kept;
+
+static void keeper_hello(void **stateptr, size_t nbytes, void *data);
+
+static act_t keeper_acts[1] = {keeper_hello};
+static role_t keeper_role = {1, keeper_acts};
+
+static void root_hello(void **stateptr, size_t nbytes, void *data)
+{
+	(void)stateptr; (void)nbytes; (void)data;
+
+	for (int i = 0; i < CHILDREN; i++) {
+		send_message(actor_id_self(), (message_t){MSG_SPAWN, 0, &child_role});
+	}
+}
+
+static void root_ready(void **stateptr, size_t nbytes, void *data)
+{
+	(void)stateptr; (void)nbytes;
+
+	children[ready++] = (actor_id_t)data;
+	if (ready < CHILDREN) {
+		return;
+	}
+
+	for (int i = 0; i < CHILDREN; i++) {
+		send_message_shared(children[i], MSG_PAYLOAD, sent);
+	}
+	message_buffer_release(sent);
+
+	send_message(actor_id_self(), (message_t){MSG_GODIE, 0, NULL});
+}
+
+static void child_hello(void **stateptr, size_t nbytes, void *data)
+{
+	(void)stateptr; (void)nbytes;
+
+	send_message((actor_id_t)data, (message_t){MSG_READY, 0, (void *)actor_id_self()});
+}
+
+static void child_payload(void **stateptr, size_t nbytes, void *data)
+{
+	(void)stateptr;
+
+	unsigned char *bytes = data;
+	if (nbytes != PAYLOAD || bytes[0] != 0x5a || bytes[PAYLOAD - 1] != 0x5a) {
+		intact = false;
+	}
+	received[__atomic_fetch_add(&received_count, 1, __ATOMIC_RELAXED)] = data;
+
+	send_message(actor_id_self(), (message_t){MSG_GODIE, 0, NULL});
+}
+
+// The buffer comes from this thread's pool, which outlives the workers that
+// release it last.
+static char *shared_fan_out()
+{
+	sent = message_buffer_alloc(PAYLOAD);
+	memset(sent, 0x5a, PAYLOAD);
+
+	actor_system_config_t config = {0};
+	config.pool_size = 2;
+
+	actor_id_t root;
+	mu_assert("create failed", actor_system_create_ex(&root, &root_role, &config) == 0);
+	actor_system_join(root);
+
+	mu_assert("payload not delivered to every child", received_count == CHILDREN);
+	mu_assert("payload corrupted", intact);
+	for (int i = 0; i < CHILDREN; i++) {
+		mu_assert("payload copied", received[i] == sent);
+	}
+
+	// The last reference returned the buffer to its pool.
+	void *again = message_buffer_alloc(PAYLOAD);
+	mu_assert("buffer not released", again == sent);
+	message_buffer_release(again);
+	return 0;
+}
+
+// The buffer comes from the pool of a worker and is still held after that
+// worker is gone.
+static void keeper_hello(void **stateptr, size_t nbytes, void *data)
+{
+	(void)stateptr; (void)nbytes; (void)data;
+
+	kept = message_buffer_alloc(PAYLOAD);
+	memset(kept, 0x5a, PAYLOAD);
+	send_message(actor_id_self(), (message_t){MSG_GODIE, 0, NULL});
+}
+
+static char *released_after_owner_left()
+{
+	actor_system_config_t config = {0};
+	config.pool_size = 1;
+
+	actor_id_t root;
+	mu_assert("create failed", actor_system_create_ex(&root, &keeper_role, &config) == 0);
+	actor_system_join(root);
+
+	unsigned char *bytes = kept;
+	mu_assert("buffer not allocated", bytes != NULL);
+	mu_assert("buffer corrupted", bytes[0] == 0x5a && bytes[PAYLOAD - 1] == 0x5a);
+	mu_assert("wrong size", message_buffer_size(kept) == PAYLOAD);
+	message_buffer_release(kept);
+	return 0;
+}
+
+static char *all_tests()
+{
+	mu_run_test(shared_fan_out);
+	mu_run_test(released_after_owner_left);
+	return 0;
+}
+
+int main()
+{
+	char *result = all_tests();
+	if (result != 0)
+	{
+		printf(__FILE__ ": %s\n", result);
+	}
+	else
+	{
+		printf(__FILE__ ": ALL TESTS PASSED\n");
+	}
+	printf(__FILE__ ": Tests run: %d\n", tests_run);
+
+	return result != 0;
+}
@@ -0,0 +1,147 @@
+#include "minunit.h"
+#include "cacti.h"
+
+#include <dirent.h>
+#include <stdatomic.h>
+#include <stdio.h>
+
+#define CAST_LIMIT_SET 4
+#define SPAWNS 8
+
+int tests_run = 0;
+
+static atomic_int children;
+
+static void idle_hello(void **stateptr, size_t nbytes, void *data);
+
+static act_t idle_acts[1] = {idle_hello};
+static role_t idle_role = {1, idle_acts};
+
+static void idle_hello(void **stateptr, size_t nbytes, void *data)
+{
+	(void)stateptr; (void)nbytes; (void)data;
+}
+
+static void spawner_hello(void **stateptr, size_t nbytes, void *data);
+static void child_hello(void **stateptr, size_t nbytes, void *data);
+
+static act_t spawner_acts[1] = {spawner_hello};
+static role_t spawner_role = {1, spawner_acts};
+
+static act_t child_acts[1] = {child_hello};
+static role_t child_role = {1, child_acts};
+
+static void spawner_hello(void **stateptr, size_t nbytes, void *data)
+{
+	(void)stateptr; (void)nbytes; (void)data;
+
+	for (int i = 0; i < SPAWNS; i++) {
+		send_message(actor_id_self(), (message_t){MSG_SPAWN, 0, &child_role});
+	}
+	send_message(actor_id_self(), (message_t){MSG_GODIE, 0, NULL});
+}
+
+static void child_hello(void **stateptr, size_t nbytes, void *data)
+{
+	(void)stateptr; (void)nbytes; (void)data;
+
+	atomic_fetch_add(&children, 1);
+	send_message(actor_id_self(), (message_t){MSG_GODIE, 0, NULL});
+}
+
+static int thread_count()
+{
+	DIR *tasks = opendir("/proc/self/task");
+	if (tasks == NULL) {
+		return -1;
+	}
+
+	int count = 0;
+	struct dirent *entry;
+	while ((entry = readdir(tasks)) != NULL) {
+		if (entry->d_name[0] != '.') {
+			count++;
+		}
+	}
+	closedir(tasks);
+
+	return count;
+}
+
+static int start_idle(actor_system_t **system, actor_id_t *root, size_t pool_size)
+{
+	actor_system_config_t config = {0};
+	config.pool_size = pool_size;
+
+	return actor_system_start(system, root, &idle_role, &config);
+}
+
+// Every system brings the same threads besides its workers, and the first
+// one also those shared by the process, so only the third tells the workers
+// apart.
+static char *pool_size_applied()
+{
+	actor_system_t *systems[3];
+	actor_id_t roots[3];
+	size_t pool_sizes[3] = {1, 1, 4};
+	int counts[4];
+
+	counts[0] = thread_count();
+	for (int i = 0; i < 3; i++) {
+		mu_assert("start failed", start_idle(&systems[i], &roots[i], pool_sizes[i]) == 0);
+		counts[i + 1] = thread_count();
+	}
+
+	actor_stats_t stats;
+	mu_assert("stats failed", actor_system_stats(systems[2], &stats) == 0);
+	size_t workers = stats.worker_count;
+	actor_stats_free(&stats);
+
+	for (int i = 0; i < 3; i++) {
+		actor_system_send(systems[i], roots[i], (message_t){MSG_GODIE, 0, NULL});
+		actor_system_wait(systems[i], roots[i]);
+	}
+
+	mu_assert("no thread count", counts[0] > 0);
+	mu_assert("wrong worker count", workers == 4);
+	mu_assert("wrong thread count", (counts[3] - counts[2]) - (counts[2] - counts[1]) == 3);
+	return 0;
+}
+
+// The root takes one of the slots, so only CAST_LIMIT_SET - 1 spawns succeed.
+static char *cast_limit_applied()
+{
+	actor_system_config_t config = {0};
+	config.pool_size = 2;
+	config.cast_limit = CAST_LIMIT_SET;
+
+	actor_id_t root;
+	mu_assert("create failed", actor_system_create_ex(&root, &spawner_role, &config) == 0);
+	actor_system_join(root);
+
+	mu_assert("cast limit not applied", atomic_load(&children) == CAST_LIMIT_SET - 1);
+	return 0;
+}
+
+static char *all_tests()
+{
+	mu_run_test(pool_size_applied);
+	mu_run_test(cast_limit_applied);
+	return 0;
+}
+
+int main()
+{
+	char *result = all_tests();
+	if (result != 0)
+	{
+		printf(__FILE__ ": %s\n", result);
+	}
+	else
+	{
+		printf(__FILE__ ": ALL TESTS PASSED\n");
+	}
+	printf(__FILE__ ": Tests run: %d\n", tests_run);
+
+	return result != 0;
+}
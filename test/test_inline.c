@@ -0,0 +1,94 @@
+#include "minunit.h"
+#include "cacti.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#define MSG_POINT 1
+#define SENT 100
+
+int tests_run = 0;
+
+typedef struct point
+{
+	long x;
+	long y;
+} point_t;
+
+static int too_large;
+static long received;
+static long wrong;
+
+static void hello(void **stateptr, size_t nbytes, void *data);
+static void point(void **stateptr, size_t nbytes, void *data);
+
+static act_t acts[2] = {hello, point};
+static role_t role = {2, acts};
+
+static void hello(void **stateptr, size_t nbytes, void *data)
+{
+	(void)stateptr; (void)nbytes; (void)data;
+
+	char large[MESSAGE_INLINE_SIZE + 1] = {0};
+	too_large = send_message_inline(actor_id_self(), MSG_POINT, large, sizeof(large));
+
+	actor_mailbox_configure(actor_id_self(), MAILBOX_GROW, 0);
+
+	// The stack copy is overwritten right away, the mailbox keeps its own.
+	point_t p;
+	for (long i = 0; i < SENT; i++) {
+		p.x = i;
+		p.y = -i;
+		send_message_inline(actor_id_self(), MSG_POINT, &p, sizeof(p));
+	}
+	memset(&p, 0, sizeof(p));
+}
+
+static void point(void **stateptr, size_t nbytes, void *data)
+{
+	(void)stateptr;
+
+	point_t *p = data;
+	if (nbytes != sizeof(point_t) || p->x != received || p->y != -received) {
+		wrong++;
+	}
+
+	if (++received == SENT) {
+		send_message(actor_id_self(), (message_t){MSG_GODIE, 0, NULL});
+	}
+}
+
+static char *inline_payloads()
+{
+	actor_id_t actor;
+	mu_assert("create failed", actor_system_create(&actor, &role) == 0);
+	actor_system_join(actor);
+
+	mu_assert("oversized payload accepted", too_large == -4);
+	mu_assert("wrong number of messages", received == SENT);
+	mu_assert("payload not copied", wrong == 0);
+	return 0;
+}
+
+static char *all_tests()
+{
+	mu_run_test(inline_payloads);
+	return 0;
+}
+
+int main()
+{
+	char *result = all_tests();
+	if (result != 0)
+	{
+		printf(__FILE__ ": %s\n", result);
+	}
+	else
+	{
+		printf(__FILE__ ": ALL TESTS PASSED\n");
+	}
+	printf(__FILE__ ": Tests run: %d\n", tests_run);
+
+	return result != 0;
+}
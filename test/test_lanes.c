@@ -0,0 +1,112 @@
+#include "minunit.h"
+#include "cacti.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+
+#define MSG_SEQ 1
+#define CAPACITY 8
+#define HIGH 2
+
+int tests_run = 0;
+
+static int overflow;
+static int godie_sent;
+static long order[CAPACITY];
+static long received;
+static long alive_after_godie;
+
+static void hello(void **stateptr, size_t nbytes, void *data);
+static void seq(void **stateptr, size_t nbytes, void *data);
+
+static act_t acts[2] = {hello, seq};
+static role_t role = {2, acts};
+
+static void hello(void **stateptr, size_t nbytes, void *data)
+{
+	(void)stateptr; (void)nbytes; (void)data;
+
+	actor_id_t self = actor_id_self();
+	actor_mailbox_configure(self, MAILBOX_REJECT, CAPACITY);
+
+	// Nothing is handled before this prompt returns, so the mailbox ends up
+	// full with normal messages on both sides of the high ones.
+	long n = 0;
+	for (; n < CAPACITY / 2; n++) {
+		send_message(self, (message_t){MSG_SEQ, 0, (void *)n});
+	}
+	for (; n < CAPACITY / 2 + HIGH; n++) {
+		send_message_priority(self, (message_t){MSG_SEQ, 0, (void *)n}, MESSAGE_HIGH);
+	}
+	for (; n < CAPACITY; n++) {
+		send_message(self, (message_t){MSG_SEQ, 0, (void *)n});
+	}
+
+	overflow = send_message_priority(self, (message_t){MSG_SEQ, 0, (void *)n}, MESSAGE_HIGH);
+	godie_sent = send_message(self, (message_t){MSG_GODIE, 0, NULL});
+}
+
+static void seq(void **stateptr, size_t nbytes, void *data)
+{
+	(void)stateptr; (void)nbytes;
+
+	// MSG_GODIE has overtaken everything, so the actor is already dead.
+	if (send_message(actor_id_self(), (message_t){MSG_SEQ, 0, NULL}) == 0) {
+		alive_after_godie++;
+	}
+
+	if (received < CAPACITY) {
+		order[received] = (long)data;
+	}
+	received++;
+}
+
+static char *lanes()
+{
+	actor_id_t actor;
+	mu_assert("create failed", actor_system_create(&actor, &role) == 0);
+	actor_system_join(actor);
+
+	mu_assert("full mailbox accepted a user message", overflow == -3);
+	mu_assert("full mailbox rejected MSG_GODIE", godie_sent == 0);
+	mu_assert("MSG_GODIE did not go first", alive_after_godie == 0);
+	mu_assert("wrong number of messages", received == CAPACITY);
+
+	long expected[CAPACITY];
+	long n = 0;
+	for (long i = CAPACITY / 2; i < CAPACITY / 2 + HIGH; i++) {
+		expected[n++] = i;
+	}
+	for (long i = 0; i < CAPACITY / 2; i++) {
+		expected[n++] = i;
+	}
+	for (long i = CAPACITY / 2 + HIGH; i < CAPACITY; i++) {
+		expected[n++] = i;
+	}
+	for (long i = 0; i < CAPACITY; i++) {
+		mu_assert("lanes out of order", order[i] == expected[i]);
+	}
+	return 0;
+}
+
+static char *all_tests()
+{
+	mu_run_test(lanes);
+	return 0;
+}
+
+int main()
+{
+	char *result = all_tests();
+	if (result != 0)
+	{
+		printf(__FILE__ ": %s\n", result);
+	}
+	else
+	{
+		printf(__FILE__ ": ALL TESTS PASSED\n");
+	}
+	printf(__FILE__ ": Tests run: %d\n", tests_run);
+
+	return result != 0;
+}
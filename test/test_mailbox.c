@@ -0,0 +1,215 @@
+#include "minunit.h"
+#include "cacti.h"
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#define MSG_RECORD 1
+#define MSG_HOLD 2
+#define CAPACITY 4
+#define SENT 10
+#define FLOOD 100000
+
+int tests_run = 0;
+
+static mailbox_policy_t policy;
+static bool use_try;
+static int results[SENT];
+static long received[SENT];
+static size_t received_count;
+static long last_accepted;
+static atomic_bool holding;
+static atomic_bool release;
+
+static void hello(void **stateptr, size_t nbytes, void *data);
+static void record(void **stateptr, size_t nbytes, void *data);
+
+static act_t acts[2] = {hello, record};
+static role_t role = {2, acts};
+
+static void stalled_hello(void **stateptr, size_t nbytes, void *data);
+static void hold(void **stateptr, size_t nbytes, void *data);
+
+static act_t stalled_acts[3] = {stalled_hello, record, hold};
+static role_t stalled_role = {3, stalled_acts};
+
+static void hello(void **stateptr, size_t nbytes, void *data)
+{
+	(void)stateptr; (void)nbytes; (void)data;
+
+	actor_id_t self = actor_id_self();
+	actor_mailbox_configure(self, policy, CAPACITY);
+
+	for (long i = 0; i < SENT; i++) {
+		message_t message = {MSG_RECORD, 0, (void *)i};
+		results[i] = use_try ? send_message_try(self, message) : send_message(self, message);
+		if (results[i] == 0) {
+			last_accepted = i;
+		}
+	}
+}
+
+static void record(void **stateptr, size_t nbytes, void *data)
+{
+	(void)stateptr; (void)nbytes;
+
+	received[received_count++] = (long)data;
+
+	if ((long)data == last_accepted) {
+		send_message(actor_id_self(), (message_t){MSG_GODIE, 0, NULL});
+	}
+}
+
+static void stalled_hello(void **stateptr, size_t nbytes, void *data)
+{
+	(void)stateptr; (void)nbytes; (void)data;
+
+	actor_mailbox_configure(actor_id_self(), MAILBOX_DROP_OLDEST, CAPACITY);
+}
+
+// Keeps the only worker busy, so nothing drains the mailbox behind it.
+static void hold(void **stateptr, size_t nbytes, void *data)
+{
+	(void)stateptr; (void)nbytes; (void)data;
+
+	atomic_store(&holding, true);
+	while (!atomic_load(&release)) {
+		usleep(1000);
+	}
+}
+
+static void run(mailbox_policy_t run_policy, bool run_try)
+{
+	policy = run_policy;
+	use_try = run_try;
+	received_count = 0;
+
+	actor_id_t actor;
+	if (actor_system_create(&actor, &role) == 0) {
+		actor_system_join(actor);
+	}
+}
+
+static char *reject()
+{
+	run(MAILBOX_REJECT, false);
+	for (int i = 0; i < SENT; i++) {
+		mu_assert("reject: wrong send result", results[i] == (i < CAPACITY ? 0 : -3));
+	}
+	mu_assert("reject: wrong number of messages", received_count == CAPACITY);
+	for (size_t i = 0; i < received_count; i++) {
+		mu_assert("reject: wrong message", received[i] == (long)i);
+	}
+	return 0;
+}
+
+static char *block_in_worker()
+{
+	run(MAILBOX_BLOCK, false);
+	mu_assert("block: worker blocked", results[SENT - 1] == -3);
+	mu_assert("block: wrong number of messages", received_count == CAPACITY);
+	return 0;
+}
+
+static char *drop_oldest()
+{
+	run(MAILBOX_DROP_OLDEST, false);
+	for (int i = 0; i < SENT; i++) {
+		mu_assert("drop: send failed", results[i] == 0);
+	}
+	mu_assert("drop: wrong number of messages", received_count == CAPACITY);
+	for (size_t i = 0; i < received_count; i++) {
+		mu_assert("drop: kept wrong message", received[i] == (long)(SENT - CAPACITY + i));
+	}
+	return 0;
+}
+
+// The consumer is stuck in a prompt, so only the senders can keep the
+// mailbox within its capacity.
+static char *drop_oldest_stalled()
+{
+	received_count = 0;
+
+	actor_system_config_t config = {0};
+	config.pool_size = 1;
+
+	actor_system_t *system;
+	actor_id_t actor;
+	mu_assert("stalled: start failed", actor_system_start(&system, &actor, &stalled_role, &config) == 0);
+	usleep(10000);
+
+	mu_assert("stalled: hold not sent", actor_system_send(system, actor, (message_t){MSG_HOLD, 0, NULL}) == 0);
+	for (int i = 0; i < 500 && !atomic_load(&holding); i++) {
+		usleep(1000);
+	}
+
+	size_t max_depth = 0;
+	int failed = 0;
+	for (long i = 0; i < FLOOD; i++) {
+		if (actor_system_send(system, actor, (message_t){MSG_RECORD, 0, (void *)-1}) != 0) {
+			failed++;
+		}
+
+		actor_counters_t counters;
+		actor_system_actor_stats(system, actor, &counters);
+		if (counters.depth > max_depth) {
+			max_depth = counters.depth;
+		}
+	}
+
+	atomic_store(&release, true);
+	actor_system_send(system, actor, (message_t){MSG_GODIE, 0, NULL});
+	actor_system_wait(system, actor);
+
+	mu_assert("stalled: send failed", failed == 0);
+	mu_assert("stalled: mailbox went over capacity", max_depth <= CAPACITY);
+	mu_assert("stalled: kept too many messages", received_count <= CAPACITY);
+	return 0;
+}
+
+static char *grow()
+{
+	run(MAILBOX_GROW, false);
+	mu_assert("grow: wrong number of messages", received_count == SENT);
+	for (size_t i = 0; i < received_count; i++) {
+		mu_assert("grow: wrong message", received[i] == (long)i);
+	}
+	return 0;
+}
+
+static char *try_grow()
+{
+	run(MAILBOX_GROW, true);
+	mu_assert("try: mailbox grew", results[CAPACITY] == -3);
+	mu_assert("try: wrong number of messages", received_count == CAPACITY);
+	return 0;
+}
+
+static char *all_tests()
+{
+	mu_run_test(reject);
+	mu_run_test(block_in_worker);
+	mu_run_test(drop_oldest);
+	mu_run_test(drop_oldest_stalled);
+	mu_run_test(grow);
+	mu_run_test(try_grow);
+	return 0;
+}
+
+int main()
+{
+	char *result = all_tests();
+	if (result != 0)
+	{
+		printf(__FILE__ ": %s\n", result);
+	}
+	else
+	{
+		printf(__FILE__ ": ALL TESTS PASSED\n");
+	}
+	printf(__FILE__ ": Tests run: %d\n", tests_run);
+
+	return result != 0;
+}
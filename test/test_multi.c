@@ -0,0 +1,217 @@
+#include "minunit.h"
+#include "cacti.h"
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#define MSG_READY 1
+#define MSG_PING 1
+#define MSG_SHARED 2
+#define CHILDREN 100
+#define PAYLOAD 4096
+
+int tests_run = 0;
+
+static actor_id_t children[CHILDREN];
+static size_t ready;
+static size_t sent;
+static long payload;
+static long pinged;
+static long wrong_payload;
+static bool shared;
+static void *buffer;
+static size_t broadcast;
+static long shared_seen;
+
+static void root_hello(void **stateptr, size_t nbytes, void *data);
+static void root_ready(void **stateptr, size_t nbytes, void *data);
+static void child_hello(void **stateptr, size_t nbytes, void *data);
+static void child_ping(void **stateptr, size_t nbytes, void *data);
+static void any_shared(void **stateptr, size_t nbytes, void *data);
+
+static act_t root_acts[3] = {root_hello, root_ready, any_shared};
+static role_t root_role = {3, root_acts};
+
+static act_t child_acts[3] = {child_hello, child_ping, any_shared};
+static role_t child_role = {3, child_acts};
+
+static atomic_bool narrow_ready;
+static atomic_long narrow_pinged;
+
+static void narrow_hello(void **stateptr, size_t nbytes, void *data);
+static void narrow_ping(void **stateptr, size_t nbytes, void *data);
+
+static act_t narrow_acts[2] = {narrow_hello, narrow_ping};
+static role_t narrow_role = {2, narrow_acts};
+
+static void root_hello(void **stateptr, size_t nbytes, void *data)
+{
+	(void)stateptr; (void)nbytes; (void)data;
+
+	actor_mailbox_configure(actor_id_self(), MAILBOX_GROW, 0);
+	for (int i = 0; i < CHILDREN; i++) {
+		send_message(actor_id_self(), (message_t){MSG_SPAWN, 0, &child_role});
+	}
+}
+
+static void root_ready(void **stateptr, size_t nbytes, void *data)
+{
+	(void)stateptr; (void)nbytes;
+
+	children[ready++] = (actor_id_t)data;
+	if (ready < CHILDREN) {
+		return;
+	}
+
+	if (shared) {
+		sent = send_message_multi_shared(children, CHILDREN, MSG_PING, buffer);
+		broadcast = send_message_broadcast_shared(MSG_SHARED, buffer);
+		message_buffer_release(buffer);
+	} else {
+		sent = send_message_multi(children, CHILDREN, (message_t){MSG_PING, 0, &payload});
+	}
+	send_message_broadcast((message_t){MSG_GODIE, 0, NULL});
+}
+
+static void child_hello(void **stateptr, size_t nbytes, void *data)
+{
+	(void)stateptr; (void)nbytes;
+
+	send_message((actor_id_t)data, (message_t){MSG_READY, 0, (void *)actor_id_self()});
+}
+
+static void child_ping(void **stateptr, size_t nbytes, void *data)
+{
+	(void)stateptr; (void)nbytes;
+
+	if (data != (shared ? buffer : &payload)) {
+		__atomic_fetch_add(&wrong_payload, 1, __ATOMIC_RELAXED);
+	}
+	__atomic_fetch_add(&pinged, 1, __ATOMIC_RELAXED);
+}
+
+static void any_shared(void **stateptr, size_t nbytes, void *data)
+{
+	(void)stateptr;
+
+	unsigned char *bytes = data;
+	if (data != buffer || nbytes != PAYLOAD || bytes[0] != 0x5a || bytes[PAYLOAD - 1] != 0x5a) {
+		__atomic_fetch_add(&wrong_payload, 1, __ATOMIC_RELAXED);
+	}
+	__atomic_fetch_add(&shared_seen, 1, __ATOMIC_RELAXED);
+}
+
+static void narrow_hello(void **stateptr, size_t nbytes, void *data)
+{
+	(void)stateptr; (void)nbytes; (void)data;
+
+	actor_mailbox_configure(actor_id_self(), MAILBOX_BLOCK, 1);
+	atomic_store(&narrow_ready, true);
+}
+
+static void narrow_ping(void **stateptr, size_t nbytes, void *data)
+{
+	(void)stateptr; (void)nbytes; (void)data;
+
+	atomic_fetch_add(&narrow_pinged, 1);
+}
+
+// The second copy finds the mailbox full and waits for the actor, which the
+// first copy made runnable, so it has to be scheduled before the wait.
+static char *multi_into_full_mailbox()
+{
+	actor_system_config_t config = {0};
+	config.pool_size = 2;
+
+	actor_system_t *system;
+	actor_id_t root;
+	mu_assert("start failed", actor_system_start(&system, &root, &narrow_role, &config) == 0);
+	for (int i = 0; i < 500 && !atomic_load(&narrow_ready); i++) {
+		usleep(1000);
+	}
+
+	actor_id_t ids[3] = {root, root, root};
+	size_t delivered = actor_system_send_multi(system, ids, 3, (message_t){MSG_PING, 0, NULL});
+	for (int i = 0; i < 500 && atomic_load(&narrow_pinged) < 3; i++) {
+		usleep(1000);
+	}
+
+	actor_system_send(system, root, (message_t){MSG_GODIE, 0, NULL});
+	actor_system_wait(system, root);
+
+	mu_assert("multi missed recipients", delivered == 3);
+	mu_assert("ping lost", atomic_load(&narrow_pinged) == 3);
+	return 0;
+}
+
+static char *multi_then_broadcast()
+{
+	actor_system_config_t config = {0};
+	config.pool_size = 2;
+
+	actor_id_t root;
+	mu_assert("create failed", actor_system_create_ex(&root, &root_role, &config) == 0);
+	actor_system_join(root);
+
+	mu_assert("multi missed recipients", sent == CHILDREN);
+	mu_assert("ping lost", pinged == CHILDREN);
+	mu_assert("payload copied", wrong_payload == 0);
+	return 0;
+}
+
+// The buffer comes from this thread's pool, which outlives the workers that
+// release it last.
+static char *shared_multi_then_broadcast()
+{
+	shared = true;
+	ready = 0;
+	pinged = 0;
+	buffer = message_buffer_alloc(PAYLOAD);
+	memset(buffer, 0x5a, PAYLOAD);
+
+	actor_system_config_t config = {0};
+	config.pool_size = 2;
+
+	actor_id_t root;
+	mu_assert("create failed", actor_system_create_ex(&root, &root_role, &config) == 0);
+	actor_system_join(root);
+
+	mu_assert("multi missed recipients", sent == CHILDREN);
+	mu_assert("broadcast missed recipients", broadcast == CHILDREN + 1);
+	mu_assert("ping lost", pinged == CHILDREN);
+	mu_assert("broadcast lost", shared_seen == CHILDREN + 1);
+	mu_assert("payload wrong", wrong_payload == 0);
+
+	// The last recipient returned the buffer to its pool.
+	void *again = message_buffer_alloc(PAYLOAD);
+	mu_assert("buffer not released", again == buffer);
+	message_buffer_release(again);
+	return 0;
+}
+
+static char *all_tests()
+{
+	mu_run_test(multi_then_broadcast);
+	mu_run_test(shared_multi_then_broadcast);
+	mu_run_test(multi_into_full_mailbox);
+	return 0;
+}
+
+int main()
+{
+	char *result = all_tests();
+	if (result != 0)
+	{
+		printf(__FILE__ ": %s\n", result);
+	}
+	else
+	{
+		printf(__FILE__ ": ALL TESTS PASSED\n");
+	}
+	printf(__FILE__ ": Tests run: %d\n", tests_run);
+
+	return result != 0;
+}
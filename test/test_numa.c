@@ -0,0 +1,168 @@
+#include "minunit.h"
+#include "cacti.h"
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#define MSG_SPAWN_LEAVES 1
+#define SPAWNERS 8
+#define LEAVES 300
+#define ACTORS (SPAWNERS * LEAVES)
+#define CHUNK 1024
+
+int tests_run = 0;
+
+static atomic_long recorded;
+static actor_id_t ids[ACTORS];
+static int nodes[ACTORS];
+static int root_node;
+
+static void root_hello(void **stateptr, size_t nbytes, void *data);
+static void spawner_hello(void **stateptr, size_t nbytes, void *data);
+static void spawner_leaves(void **stateptr, size_t nbytes, void *data);
+static void leaf_hello(void **stateptr, size_t nbytes, void *data);
+
+static act_t root_acts[1] = {root_hello};
+static act_t spawner_acts[2] = {spawner_hello, spawner_leaves};
+static act_t leaf_acts[1] = {leaf_hello};
+
+static role_t root_role = {1, root_acts};
+static role_t spawner_role = {2, spawner_acts};
+static role_t leaf_role = {1, leaf_acts};
+
+// The spawners are spread over the workers by stealing, so their leaves are
+// placed on whichever node each one ends up running on.
+static void root_hello(void **stateptr, size_t nbytes, void *data)
+{
+	(void)stateptr; (void)nbytes; (void)data;
+
+	actor_id_t self = actor_id_self();
+	root_node = actor_numa_node(self);
+	for (int i = 0; i < SPAWNERS; i++) {
+		send_message(self, (message_t){MSG_SPAWN, 0, &spawner_role});
+	}
+	send_message(self, (message_t){MSG_GODIE, 0, NULL});
+}
+
+static void spawner_hello(void **stateptr, size_t nbytes, void *data)
+{
+	(void)stateptr; (void)nbytes; (void)data;
+
+	send_message(actor_id_self(), (message_t){MSG_SPAWN_LEAVES, 0, NULL});
+}
+
+static void spawner_leaves(void **stateptr, size_t nbytes, void *data)
+{
+	(void)stateptr; (void)nbytes; (void)data;
+
+	actor_id_t self = actor_id_self();
+	for (int i = 0; i < LEAVES; i++) {
+		send_message(self, (message_t){MSG_SPAWN, 0, &leaf_role});
+	}
+	send_message(self, (message_t){MSG_GODIE, 0, NULL});
+}
+
+static void leaf_hello(void **stateptr, size_t nbytes, void *data)
+{
+	(void)stateptr; (void)nbytes; (void)data;
+
+	actor_id_t self = actor_id_self();
+	long i = atomic_fetch_add(&recorded, 1);
+	if (i < ACTORS) {
+		ids[i] = self;
+		nodes[i] = actor_numa_node(self);
+	}
+	send_message(self, (message_t){MSG_GODIE, 0, NULL});
+}
+
+static int run(const actor_system_config_t *config)
+{
+	atomic_store(&recorded, 0);
+	root_node = -1;
+
+	actor_system_t *system;
+	actor_id_t root;
+	if (actor_system_start(&system, &root, &root_role, config) != 0) {
+		return -1;
+	}
+	actor_system_wait(system, root);
+
+	return 0;
+}
+
+// Slots are handed out a chunk per node at a time, so a chunk never holds
+// actors of two nodes.
+static bool chunks_consistent(int node_count)
+{
+	static int chunk_nodes[ACTORS / CHUNK + SPAWNERS + 1];
+	for (size_t i = 0; i < sizeof(chunk_nodes) / sizeof(chunk_nodes[0]); i++) {
+		chunk_nodes[i] = -1;
+	}
+
+	for (long i = 0; i < ACTORS; i++) {
+		if (nodes[i] < 0 || nodes[i] >= node_count) {
+			return false;
+		}
+
+		size_t chunk = ACTOR_ID_INDEX(ids[i]) / CHUNK;
+		if (chunk >= sizeof(chunk_nodes) / sizeof(chunk_nodes[0])) {
+			return false;
+		}
+		if (chunk_nodes[chunk] == -1) {
+			chunk_nodes[chunk] = nodes[i];
+		} else if (chunk_nodes[chunk] != nodes[i]) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static char *simulated_nodes()
+{
+	actor_system_config_t config = {0};
+	config.pool_size = 4;
+	config.numa_nodes = 2;
+	config.recycle_actors = true;
+
+	mu_assert("start failed", run(&config) == 0);
+	mu_assert("wrong number of leaves", atomic_load(&recorded) == ACTORS);
+	mu_assert("root spawned from outside not on node 0", root_node == 0);
+	mu_assert("chunk shared by two nodes", chunks_consistent(2));
+	return 0;
+}
+
+static char *single_node()
+{
+	actor_system_config_t config = {0};
+	config.pool_size = 4;
+
+	mu_assert("start failed", run(&config) == 0);
+	mu_assert("wrong number of leaves", atomic_load(&recorded) == ACTORS);
+	mu_assert("unpinned workers not on node 0", chunks_consistent(1));
+	return 0;
+}
+
+static char *all_tests()
+{
+	mu_run_test(simulated_nodes);
+	mu_run_test(single_node);
+	return 0;
+}
+
+int main()
+{
+	char *result = all_tests();
+	if (result != 0)
+	{
+		printf(__FILE__ ": %s\n", result);
+	}
+	else
+	{
+		printf(__FILE__ ": ALL TESTS PASSED\n");
+	}
+	printf(__FILE__ ": Tests run: %d\n", tests_run);
+
+	return result != 0;
+}
@@ -0,0 +1,191 @@
+#include "minunit.h"
+#include "cacti.h"
+
+#include <stdatomic.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#define MSG_WORK 1
+#define MSG_KILL 2
+#define CHILDREN 16
+#define QUEUED 200
+#define DEPTH 10
+
+int tests_run = 0;
+
+static actor_id_t children[CHILDREN];
+static atomic_int joined;
+static atomic_long handled;
+static atomic_long leaves;
+
+static void idle_root_hello(void **stateptr, size_t nbytes, void *data);
+static void idle_root_work(void **stateptr, size_t nbytes, void *data);
+static void idle_root_kill(void **stateptr, size_t nbytes, void *data);
+static void idle_child_hello(void **stateptr, size_t nbytes, void *data);
+
+static act_t idle_root_acts[3] = {idle_root_hello, idle_root_work, idle_root_kill};
+static role_t idle_root_role = {3, idle_root_acts};
+
+static act_t idle_child_acts[1] = {idle_child_hello};
+static role_t idle_child_role = {1, idle_child_acts};
+
+static void idle_root_hello(void **stateptr, size_t nbytes, void *data)
+{
+	(void)stateptr; (void)nbytes; (void)data;
+
+	for (int i = 0; i < CHILDREN; i++) {
+		send_message(actor_id_self(), (message_t){MSG_SPAWN, 0, &idle_child_role});
+	}
+}
+
+// Children report in and then wait for nothing but their death.
+static void idle_root_work(void **stateptr, size_t nbytes, void *data)
+{
+	(void)stateptr; (void)nbytes;
+
+	children[atomic_fetch_add(&joined, 1)] = (actor_id_t)data;
+}
+
+static void idle_root_kill(void **stateptr, size_t nbytes, void *data)
+{
+	(void)stateptr; (void)nbytes; (void)data;
+
+	send_message_multi(children, CHILDREN, (message_t){MSG_GODIE, 0, NULL});
+	send_message(actor_id_self(), (message_t){MSG_GODIE, 0, NULL});
+}
+
+static void idle_child_hello(void **stateptr, size_t nbytes, void *data)
+{
+	(void)stateptr; (void)nbytes;
+
+	send_message((actor_id_t)data, (message_t){MSG_WORK, 0, (void *)actor_id_self()});
+}
+
+static void draining_hello(void **stateptr, size_t nbytes, void *data);
+static void draining_work(void **stateptr, size_t nbytes, void *data);
+
+static act_t draining_acts[2] = {draining_hello, draining_work};
+static role_t draining_role = {2, draining_acts};
+
+// MSG_GODIE overtakes the work in the system lane, so the actor is dead
+// while its mailbox still holds all of it.
+static void draining_hello(void **stateptr, size_t nbytes, void *data)
+{
+	(void)stateptr; (void)nbytes; (void)data;
+
+	actor_id_t self = actor_id_self();
+	for (int i = 0; i < QUEUED; i++) {
+		send_message(self, (message_t){MSG_WORK, 0, NULL});
+	}
+	send_message(self, (message_t){MSG_GODIE, 0, NULL});
+}
+
+static void draining_work(void **stateptr, size_t nbytes, void *data)
+{
+	(void)stateptr; (void)nbytes; (void)data;
+
+	atomic_fetch_add(&handled, 1);
+}
+
+static void tree_hello(void **stateptr, size_t nbytes, void *data);
+
+static act_t tree_acts[1] = {tree_hello};
+static role_t tree_role = {1, tree_acts};
+
+// Every actor of the binary tree spawns its two children and dies at once,
+// so the system keeps going through moments with nothing alive but spawns.
+// nbytes carries the depth, which the system starts at 1 for the root.
+static void tree_hello(void **stateptr, size_t nbytes, void *data)
+{
+	(void)stateptr; (void)data;
+
+	actor_id_t self = actor_id_self();
+	if (nbytes < DEPTH) {
+		send_message(self, (message_t){MSG_SPAWN, nbytes + 1, &tree_role});
+		send_message(self, (message_t){MSG_SPAWN, nbytes + 1, &tree_role});
+	} else {
+		atomic_fetch_add(&leaves, 1);
+	}
+	send_message(self, (message_t){MSG_GODIE, 0, NULL});
+}
+
+static char *idle_actors()
+{
+	actor_system_config_t config = {0};
+	config.pool_size = 4;
+
+	actor_system_t *system;
+	actor_id_t root;
+	mu_assert("start failed", actor_system_start(&system, &root, &idle_root_role, &config) == 0);
+
+	for (int i = 0; i < 500 && atomic_load(&joined) < CHILDREN; i++) {
+		usleep(1000);
+	}
+	usleep(20000);
+
+	actor_stats_t stats;
+	mu_assert("stats failed", actor_system_stats(system, &stats) == 0);
+	size_t alive = stats.actors;
+	actor_stats_free(&stats);
+
+	mu_assert("kill not delivered", actor_system_send(system, root, (message_t){MSG_KILL, 0, NULL}) == 0);
+	actor_system_wait(system, root);
+
+	mu_assert("children missing", atomic_load(&joined) == CHILDREN);
+	mu_assert("idle actors counted dead", alive == CHILDREN + 1);
+	return 0;
+}
+
+static char *dead_actor_drained()
+{
+	actor_system_config_t config = {0};
+	config.pool_size = 2;
+	config.mailbox_policy = MAILBOX_GROW;
+
+	actor_system_t *system;
+	actor_id_t root;
+	mu_assert("start failed", actor_system_start(&system, &root, &draining_role, &config) == 0);
+	actor_system_wait(system, root);
+
+	mu_assert("joined before the mailbox was drained", atomic_load(&handled) == QUEUED);
+	return 0;
+}
+
+static char *spawn_churn()
+{
+	actor_system_config_t config = {0};
+	config.pool_size = 4;
+	config.recycle_actors = true;
+
+	actor_system_t *system;
+	actor_id_t root;
+	mu_assert("start failed", actor_system_start(&system, &root, &tree_role, &config) == 0);
+	actor_system_wait(system, root);
+
+	mu_assert("joined before the tree was done", atomic_load(&leaves) == 1 << (DEPTH - 1));
+	return 0;
+}
+
+static char *all_tests()
+{
+	mu_run_test(idle_actors);
+	mu_run_test(dead_actor_drained);
+	mu_run_test(spawn_churn);
+	return 0;
+}
+
+int main()
+{
+	char *result = all_tests();
+	if (result != 0)
+	{
+		printf(__FILE__ ": %s\n", result);
+	}
+	else
+	{
+		printf(__FILE__ ": ALL TESTS PASSED\n");
+	}
+	printf(__FILE__ ": Tests run: %d\n", tests_run);
+
+	return result != 0;
+}
@@ -0,0 +1,90 @@
+#include "minunit.h"
+#include "cacti.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+
+#define MSG_PING 1
+#define CAST 16
+#define CHAIN 1000
+
+int tests_run = 0;
+
+static long reached;
+static long reused;
+static long out_of_range;
+static int stale_result;
+
+static void link_hello(void **stateptr, size_t nbytes, void *data);
+static void link_ping(void **stateptr, size_t nbytes, void *data);
+
+static act_t link_acts[2] = {link_hello, link_ping};
+static role_t link_role = {2, link_acts};
+
+// Every link spawns the next one and dies, so only a few are alive at once.
+static void link_hello(void **stateptr, size_t nbytes, void *data)
+{
+	(void)stateptr; (void)nbytes; (void)data;
+
+	actor_id_t self = actor_id_self();
+	if (ACTOR_ID_GENERATION(self) > 0) {
+		reused++;
+	}
+	if (ACTOR_ID_INDEX(self) >= CAST) {
+		out_of_range++;
+	}
+
+	if (++reached == CHAIN) {
+		// The previous generation of this slot is dead and released.
+		actor_id_t stale = self - ((actor_id_t)1 << ACTOR_INDEX_BITS);
+		stale_result = ACTOR_ID_GENERATION(self) > 0 ? send_message(stale, (message_t){MSG_PING, 0, NULL}) : 0;
+	} else {
+		send_message(self, (message_t){MSG_SPAWN, 0, &link_role});
+	}
+	send_message(self, (message_t){MSG_GODIE, 0, NULL});
+}
+
+static void link_ping(void **stateptr, size_t nbytes, void *data)
+{
+	(void)stateptr; (void)nbytes; (void)data;
+}
+
+static char *recycled_chain()
+{
+	actor_system_config_t config = {0};
+	config.pool_size = 2;
+	config.cast_limit = CAST;
+	config.recycle_actors = true;
+
+	actor_id_t root;
+	mu_assert("create failed", actor_system_create_ex(&root, &link_role, &config) == 0);
+	actor_system_join(root);
+
+	mu_assert("chain stopped at the cast limit", reached == CHAIN);
+	mu_assert("slots were not reused", reused > 0);
+	mu_assert("index beyond the cast limit", out_of_range == 0);
+	mu_assert("stale id accepted a message", stale_result == -1);
+	return 0;
+}
+
+static char *all_tests()
+{
+	mu_run_test(recycled_chain);
+	return 0;
+}
+
+int main()
+{
+	char *result = all_tests();
+	if (result != 0)
+	{
+		printf(__FILE__ ": %s\n", result);
+	}
+	else
+	{
+		printf(__FILE__ ": ALL TESTS PASSED\n");
+	}
+	printf(__FILE__ ": Tests run: %d\n", tests_run);
+
+	return result != 0;
+}
@@ -0,0 +1,129 @@
+#include "minunit.h"
+#include "cacti.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#define MSG_WORK 1
+#define SENT 500
+#define POOL 2
+
+int tests_run = 0;
+
+static void hello(void **stateptr, size_t nbytes, void *data);
+static void work(void **stateptr, size_t nbytes, void *data);
+
+static act_t acts[2] = {hello, work};
+static role_t role = {2, acts};
+
+// Nothing is handled before this prompt returns, so every send finds the
+// mailbox one message deeper.
+static void hello(void **stateptr, size_t nbytes, void *data)
+{
+	(void)stateptr; (void)nbytes; (void)data;
+
+	actor_id_t self = actor_id_self();
+	actor_mailbox_configure(self, MAILBOX_GROW, 0);
+	for (int i = 0; i < SENT; i++) {
+		send_message(self, (message_t){MSG_WORK, 0, NULL});
+	}
+}
+
+static void work(void **stateptr, size_t nbytes, void *data)
+{
+	(void)stateptr; (void)nbytes; (void)data;
+}
+
+static char *histogram_buckets()
+{
+	for (size_t i = 1; i < ACTOR_HISTOGRAM_BUCKETS; i++) {
+		mu_assert("bucket bounds not increasing",
+			actor_histogram_bucket_nsec(i) > actor_histogram_bucket_nsec(i - 1));
+	}
+	mu_assert("wrong bucket bound", actor_histogram_bucket_nsec(8) == 8);
+	mu_assert("wrong bucket bound", actor_histogram_bucket_nsec(17) == 18);
+
+	actor_histogram_t histogram = {0};
+	mu_assert("empty histogram has a percentile", actor_histogram_percentile(&histogram, 0.5) == 0);
+
+	histogram.buckets[3] = 90;
+	histogram.buckets[40] = 10;
+	histogram.count = 100;
+	mu_assert("wrong median", actor_histogram_percentile(&histogram, 0.5) == 3);
+	mu_assert("wrong tail", actor_histogram_percentile(&histogram, 0.99) == actor_histogram_bucket_nsec(40));
+	return 0;
+}
+
+static char *counters()
+{
+	actor_system_config_t config = {0};
+	config.pool_size = POOL;
+
+	actor_system_t *system;
+	actor_id_t root;
+	mu_assert("start failed", actor_system_start(&system, &root, &role, &config) == 0);
+
+	// The hello and SENT messages, counted once each batch is done.
+	actor_counters_t actor;
+	for (int i = 0; i < 500; i++) {
+		mu_assert("no such actor", actor_system_actor_stats(system, root, &actor) == 0);
+		if (actor.processed == SENT + 1) {
+			break;
+		}
+		usleep(1000);
+	}
+
+	actor_stats_t stats;
+	mu_assert("stats failed", actor_system_stats(system, &stats) == 0);
+
+	uint64_t processed = 0;
+	uint64_t busy = 0;
+	for (size_t i = 0; i < stats.worker_count; i++) {
+		processed += stats.workers[i].processed;
+		busy += stats.workers[i].busy_nsec;
+	}
+	size_t worker_count = stats.worker_count;
+	uint64_t handled = stats.handler.count;
+	uint64_t waited = stats.queue_wait.count;
+	bool tail_below_max = actor_histogram_percentile(&stats.handler, 0.99) <= stats.handler.max_nsec;
+	actor_stats_free(&stats);
+
+	actor_system_send(system, root, (message_t){MSG_GODIE, 0, NULL});
+	actor_system_wait(system, root);
+
+	mu_assert("wrong enqueued count", actor.enqueued == SENT + 1);
+	mu_assert("wrong processed count", actor.processed == SENT + 1);
+	mu_assert("mailbox not drained", actor.depth == 0);
+	mu_assert("max depth missed", actor.max_depth == SENT);
+	mu_assert("wrong worker count", worker_count == POOL);
+	mu_assert("workers missed messages", processed == SENT + 1);
+	mu_assert("no message timed", waited > 0 && waited <= SENT + 1);
+	mu_assert("histograms disagree", handled == waited);
+	mu_assert("no busy time", busy > 0);
+	mu_assert("percentile beyond the maximum", tail_below_max);
+	return 0;
+}
+
+static char *all_tests()
+{
+	mu_run_test(histogram_buckets);
+	mu_run_test(counters);
+	return 0;
+}
+
+int main()
+{
+	char *result = all_tests();
+	if (result != 0)
+	{
+		printf(__FILE__ ": %s\n", result);
+	}
+	else
+	{
+		printf(__FILE__ ": ALL TESTS PASSED\n");
+	}
+	printf(__FILE__ ": Tests run: %d\n", tests_run);
+
+	return result != 0;
+}
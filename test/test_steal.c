@@ -0,0 +1,93 @@
+#include "minunit.h"
+#include "cacti.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#define CHILDREN 64
+
+int tests_run = 0;
+
+static pthread_t spawner;
+static pthread_t ran_on[CHILDREN];
+static atomic_int children;
+
+static void root_hello(void **stateptr, size_t nbytes, void *data);
+static void child_hello(void **stateptr, size_t nbytes, void *data);
+
+static act_t root_acts[1] = {root_hello};
+static role_t root_role = {1, root_acts};
+
+static act_t child_acts[1] = {child_hello};
+static role_t child_role = {1, child_acts};
+
+// The spawns are handled in the same batch as the hello, so every child is
+// queued on the worker running the root.
+static void root_hello(void **stateptr, size_t nbytes, void *data)
+{
+	(void)stateptr; (void)nbytes; (void)data;
+
+	spawner = pthread_self();
+	for (int i = 0; i < CHILDREN; i++) {
+		send_message(actor_id_self(), (message_t){MSG_SPAWN, 0, &child_role});
+	}
+	send_message(actor_id_self(), (message_t){MSG_GODIE, 0, NULL});
+}
+
+// Sleeping leaves the CPU to the other worker, which can only get children
+// off the spawner's queue.
+static void child_hello(void **stateptr, size_t nbytes, void *data)
+{
+	(void)stateptr; (void)nbytes; (void)data;
+
+	ran_on[atomic_fetch_add(&children, 1)] = pthread_self();
+	usleep(2000);
+	send_message(actor_id_self(), (message_t){MSG_GODIE, 0, NULL});
+}
+
+static char *children_stolen()
+{
+	actor_system_config_t config = {0};
+	config.pool_size = 2;
+	config.batch_limit = CHILDREN + 2;
+	config.batch_usec = -1;
+
+	actor_id_t root;
+	mu_assert("create failed", actor_system_create_ex(&root, &root_role, &config) == 0);
+	actor_system_join(root);
+
+	mu_assert("children missing", atomic_load(&children) == CHILDREN);
+
+	int stolen = 0;
+	for (int i = 0; i < CHILDREN; i++) {
+		if (!pthread_equal(ran_on[i], spawner)) {
+			stolen++;
+		}
+	}
+	mu_assert("no child stolen", stolen > 0);
+	return 0;
+}
+
+static char *all_tests()
+{
+	mu_run_test(children_stolen);
+	return 0;
+}
+
+int main()
+{
+	char *result = all_tests();
+	if (result != 0)
+	{
+		printf(__FILE__ ": %s\n", result);
+	}
+	else
+	{
+		printf(__FILE__ ": ALL TESTS PASSED\n");
+	}
+	printf(__FILE__ ": Tests run: %d\n", tests_run);
+
+	return result != 0;
+}
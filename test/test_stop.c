@@ -0,0 +1,271 @@
+#include "minunit.h"
+#include "cacti.h"
+
+#include <pthread.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#define MSG_LOOP 1
+#define MSG_HOLD 1
+#define MSG_COUNT 2
+#define MSG_ASK 3
+#define IDLE_ACTORS 10000
+#define QUEUED 100
+#define ANSWER 42
+
+int tests_run = 0;
+
+static atomic_long spawned;
+static atomic_long loops;
+static atomic_bool holding;
+static atomic_bool release;
+static actor_id_t holder;
+static atomic_bool gate_closed;
+static atomic_bool gate_open;
+static atomic_long counted;
+
+static void busy_hello(void **stateptr, size_t nbytes, void *data);
+static void busy_loop(void **stateptr, size_t nbytes, void *data);
+static void idle_hello(void **stateptr, size_t nbytes, void *data);
+
+static act_t busy_acts[2] = {busy_hello, busy_loop};
+static role_t busy_role = {2, busy_acts};
+
+static act_t idle_acts[1] = {idle_hello};
+static role_t idle_role = {1, idle_acts};
+
+// The root never dies and never stops sending to itself, next to plenty of
+// actors that stay alive doing nothing, so only a stop ends the system.
+static void busy_hello(void **stateptr, size_t nbytes, void *data)
+{
+	(void)stateptr; (void)nbytes; (void)data;
+
+	actor_id_t self = actor_id_self();
+	actor_mailbox_configure(self, MAILBOX_GROW, 0);
+	for (int i = 0; i < IDLE_ACTORS; i++) {
+		send_message(self, (message_t){MSG_SPAWN, 0, &idle_role});
+	}
+	send_message(self, (message_t){MSG_LOOP, 0, NULL});
+}
+
+static void busy_loop(void **stateptr, size_t nbytes, void *data)
+{
+	(void)stateptr; (void)nbytes; (void)data;
+
+	atomic_fetch_add(&loops, 1);
+	send_message(actor_id_self(), (message_t){MSG_LOOP, 0, NULL});
+}
+
+static void idle_hello(void **stateptr, size_t nbytes, void *data)
+{
+	(void)stateptr; (void)nbytes; (void)data;
+
+	atomic_fetch_add(&spawned, 1);
+}
+
+static void holder_hello(void **stateptr, size_t nbytes, void *data);
+static void holder_hold(void **stateptr, size_t nbytes, void *data);
+
+static act_t holder_acts[2] = {holder_hello, holder_hold};
+static role_t holder_role = {2, holder_acts};
+
+static void holder_hello(void **stateptr, size_t nbytes, void *data)
+{
+	(void)stateptr; (void)nbytes; (void)data;
+
+	actor_mailbox_configure(actor_id_self(), MAILBOX_BLOCK, 1);
+}
+
+// Keeps a worker busy, so nothing drains the mailbox behind it.
+static void holder_hold(void **stateptr, size_t nbytes, void *data)
+{
+	(void)stateptr; (void)nbytes; (void)data;
+
+	atomic_store(&holding, true);
+	while (!atomic_load(&release)) {
+		usleep(1000);
+	}
+}
+
+static void queue_hello(void **stateptr, size_t nbytes, void *data);
+static void queue_hold(void **stateptr, size_t nbytes, void *data);
+static void queue_count(void **stateptr, size_t nbytes, void *data);
+static void queue_ask(void **stateptr, size_t nbytes, void *data);
+
+static act_t queue_acts[4] = {queue_hello, queue_hold, queue_count, queue_ask};
+static role_t queue_role = {4, queue_acts};
+
+static void queue_hello(void **stateptr, size_t nbytes, void *data)
+{
+	(void)stateptr; (void)nbytes; (void)data;
+
+	actor_mailbox_configure(actor_id_self(), MAILBOX_GROW, 0);
+}
+
+// Holds the only worker while messages pile up behind it.
+static void queue_hold(void **stateptr, size_t nbytes, void *data)
+{
+	(void)stateptr; (void)nbytes; (void)data;
+
+	atomic_store(&gate_closed, true);
+	while (!atomic_load(&gate_open)) {
+		usleep(1000);
+	}
+}
+
+static void queue_count(void **stateptr, size_t nbytes, void *data)
+{
+	(void)stateptr; (void)nbytes; (void)data;
+
+	atomic_fetch_add(&counted, 1);
+	send_message(actor_id_self(), (message_t){MSG_COUNT, 0, NULL});
+}
+
+static void queue_ask(void **stateptr, size_t nbytes, void *data)
+{
+	(void)stateptr; (void)nbytes; (void)data;
+
+	actor_reply(actor_reply_handle(), (message_t){MSG_ASK, 0, (void *)ANSWER});
+}
+
+static void *blocked_send(void *arg)
+{
+	(void)arg;
+
+	return (void *)(long)send_message(holder, (message_t){MSG_HOLD, 0, NULL});
+}
+
+static char *sigint_stops()
+{
+	actor_system_config_t config = {0};
+	config.pool_size = 2;
+	config.cast_limit = IDLE_ACTORS + 1;
+
+	actor_system_t *system;
+	actor_id_t root;
+	mu_assert("start failed", actor_system_start(&system, &root, &busy_role, &config) == 0);
+
+	for (int i = 0; i < 500 && atomic_load(&spawned) < IDLE_ACTORS; i++) {
+		usleep(1000);
+	}
+	mu_assert("send failed before the stop", actor_system_send(system, root, (message_t){MSG_LOOP, 0, NULL}) == 0);
+
+	raise(SIGINT);
+	int after = actor_system_send(system, root, (message_t){MSG_LOOP, 0, NULL});
+	actor_system_wait(system, root);
+
+	mu_assert("idle actors missing", atomic_load(&spawned) == IDLE_ACTORS);
+	mu_assert("root never ran", atomic_load(&loops) > 0);
+	mu_assert("send accepted while stopping", after == -1);
+	return 0;
+}
+
+static char *next_system_runs()
+{
+	atomic_store(&loops, 0);
+
+	actor_system_t *system;
+	actor_id_t root;
+	mu_assert("start failed", actor_system_start(&system, &root, &busy_role, NULL) == 0);
+
+	for (int i = 0; i < 500 && atomic_load(&loops) < 100; i++) {
+		usleep(1000);
+	}
+	long ran = atomic_load(&loops);
+
+	raise(SIGINT);
+	actor_system_wait(system, root);
+
+	mu_assert("system after a stop did not run", ran >= 100);
+	return 0;
+}
+
+static char *blocked_sender_released()
+{
+	actor_system_config_t config = {0};
+	config.pool_size = 2;
+
+	mu_assert("create failed", actor_system_create_ex(&holder, &holder_role, &config) == 0);
+	usleep(10000);
+	mu_assert("hold not sent", send_message(holder, (message_t){MSG_HOLD, 0, NULL}) == 0);
+	for (int i = 0; i < 500 && !atomic_load(&holding); i++) {
+		usleep(1000);
+	}
+	mu_assert("mailbox not filled", send_message(holder, (message_t){MSG_HOLD, 0, NULL}) == 0);
+
+	pthread_t sender;
+	mu_assert("no thread", pthread_create(&sender, NULL, blocked_send, NULL) == 0);
+	usleep(20000);
+
+	raise(SIGINT);
+	void *result;
+	pthread_join(sender, &result);
+	atomic_store(&release, true);
+	actor_system_join(holder);
+
+	mu_assert("blocked send not failed by the stop", (long)result == -1);
+	return 0;
+}
+
+// Messages queued before the stop still run and their asks are answered,
+// while the sends made after it, those of the prompts included, fail.
+static char *queued_messages_run()
+{
+	actor_system_config_t config = {0};
+	config.pool_size = 1;
+
+	actor_system_t *system;
+	actor_id_t root;
+	mu_assert("start failed", actor_system_start(&system, &root, &queue_role, &config) == 0);
+
+	mu_assert("hold not sent", actor_system_send(system, root, (message_t){MSG_HOLD, 0, NULL}) == 0);
+	for (int i = 0; i < 500 && !atomic_load(&gate_closed); i++) {
+		usleep(1000);
+	}
+	for (int i = 0; i < QUEUED; i++) {
+		mu_assert("count not sent", actor_system_send(system, root, (message_t){MSG_COUNT, 0, NULL}) == 0);
+	}
+	actor_future_t *future = actor_system_ask(system, root, (message_t){MSG_ASK, 0, NULL}, -1);
+	mu_assert("ask not sent", future != NULL);
+
+	raise(SIGINT);
+	int after = actor_system_send(system, root, (message_t){MSG_COUNT, 0, NULL});
+	atomic_store(&gate_open, true);
+
+	message_t reply;
+	int status = actor_future_wait(future, &reply);
+	actor_future_free(future);
+	actor_system_wait(system, root);
+
+	mu_assert("send accepted while stopping", after == -1);
+	mu_assert("ask failed by the stop", status == 0 && (long)reply.data == ANSWER);
+	mu_assert("queued messages dropped", atomic_load(&counted) == QUEUED);
+	return 0;
+}
+
+static char *all_tests()
+{
+	mu_run_test(sigint_stops);
+	mu_run_test(next_system_runs);
+	mu_run_test(blocked_sender_released);
+	mu_run_test(queued_messages_run);
+	return 0;
+}
+
+int main()
+{
+	char *result = all_tests();
+	if (result != 0)
+	{
+		printf(__FILE__ ": %s\n", result);
+	}
+	else
+	{
+		printf(__FILE__ ": ALL TESTS PASSED\n");
+	}
+	printf(__FILE__ ": Tests run: %d\n", tests_run);
+
+	return result != 0;
+}
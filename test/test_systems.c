@@ -0,0 +1,108 @@
+#include "minunit.h"
+#include "cacti.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+
+#define MSG_COUNT 1
+#define SYSTEMS 2
+#define CHILDREN 8
+#define MESSAGES 100
+
+int tests_run = 0;
+
+static actor_system_t *handles[SYSTEMS];
+static long received[SYSTEMS];
+static int wrong_system;
+
+static void root_hello(void **stateptr, size_t nbytes, void *data);
+static void root_count(void **stateptr, size_t nbytes, void *data);
+static void child_hello(void **stateptr, size_t nbytes, void *data);
+
+static act_t root_acts[2] = {root_hello, root_count};
+static role_t root_role = {2, root_acts};
+
+static act_t child_acts[1] = {child_hello};
+static role_t child_role = {1, child_acts};
+
+static int system_index()
+{
+	for (int i = 0; i < SYSTEMS; i++) {
+		if (handles[i] == actor_system_self()) {
+			return i;
+		}
+	}
+	wrong_system++;
+	return 0;
+}
+
+static void root_hello(void **stateptr, size_t nbytes, void *data)
+{
+	(void)stateptr; (void)nbytes; (void)data;
+
+	actor_mailbox_configure(actor_id_self(), MAILBOX_GROW, 0);
+	for (int i = 0; i < CHILDREN; i++) {
+		send_message(actor_id_self(), (message_t){MSG_SPAWN, 0, &child_role});
+	}
+}
+
+static void root_count(void **stateptr, size_t nbytes, void *data)
+{
+	(void)stateptr; (void)nbytes; (void)data;
+
+	if (++received[system_index()] == CHILDREN * MESSAGES) {
+		send_message(actor_id_self(), (message_t){MSG_GODIE, 0, NULL});
+	}
+}
+
+static void child_hello(void **stateptr, size_t nbytes, void *data)
+{
+	(void)stateptr; (void)nbytes;
+
+	for (int i = 0; i < MESSAGES; i++) {
+		send_message((actor_id_t)data, (message_t){MSG_COUNT, 0, NULL});
+	}
+	send_message(actor_id_self(), (message_t){MSG_GODIE, 0, NULL});
+}
+
+static char *independent_systems()
+{
+	actor_system_config_t config = {0};
+	config.pool_size = 2;
+
+	actor_id_t roots[SYSTEMS];
+	for (int i = 0; i < SYSTEMS; i++) {
+		mu_assert("start failed", actor_system_start(&handles[i], &roots[i], &root_role, &config) == 0);
+	}
+	for (int i = 0; i < SYSTEMS; i++) {
+		actor_system_wait(handles[i], roots[i]);
+	}
+
+	mu_assert("prompt ran in a foreign system", wrong_system == 0);
+	for (int i = 0; i < SYSTEMS; i++) {
+		mu_assert("messages crossed systems", received[i] == CHILDREN * MESSAGES);
+	}
+	return 0;
+}
+
+static char *all_tests()
+{
+	mu_run_test(independent_systems);
+	return 0;
+}
+
+int main()
+{
+	char *result = all_tests();
+	if (result != 0)
+	{
+		printf(__FILE__ ": %s\n", result);
+	}
+	else
+	{
+		printf(__FILE__ ": ALL TESTS PASSED\n");
+	}
+	printf(__FILE__ ": Tests run: %d\n", tests_run);
+
+	return result != 0;
+}
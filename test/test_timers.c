@@ -0,0 +1,122 @@
+#include "minunit.h"
+#include "cacti.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <time.h>
+
+#define MSG_TICK 1
+#define MSG_ONCE 2
+#define MSG_NEVER 3
+#define TICKS 5
+
+int tests_run = 0;
+
+static actor_timer_t ticker;
+static long ticks;
+static long ticks_at_once = -1;
+static long onces;
+static long nevers;
+static int cancelled_twice;
+static struct timespec start;
+static double first_tick_ms;
+static double once_ms;
+
+static void hello(void **stateptr, size_t nbytes, void *data);
+static void tick(void **stateptr, size_t nbytes, void *data);
+static void once(void **stateptr, size_t nbytes, void *data);
+static void never(void **stateptr, size_t nbytes, void *data);
+
+static act_t acts[4] = {hello, tick, once, never};
+static role_t role = {4, acts};
+
+static double elapsed_ms()
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec - start.tv_sec) * 1e3 + (now.tv_nsec - start.tv_nsec) / 1e6;
+}
+
+static void hello(void **stateptr, size_t nbytes, void *data)
+{
+	(void)stateptr; (void)nbytes; (void)data;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	actor_id_t self = actor_id_self();
+	ticker = send_message_every(self, (message_t){MSG_TICK, 0, NULL}, 5000, 2000);
+	send_message_after(self, (message_t){MSG_ONCE, 0, NULL}, 50000);
+
+	actor_timer_t doomed = send_message_after(self, (message_t){MSG_NEVER, 0, NULL}, 3000);
+	actor_timer_cancel(doomed);
+	cancelled_twice = actor_timer_cancel(doomed);
+}
+
+static void tick(void **stateptr, size_t nbytes, void *data)
+{
+	(void)stateptr; (void)nbytes; (void)data;
+
+	if (ticks++ == 0) {
+		first_tick_ms = elapsed_ms();
+	}
+	if (ticks == TICKS) {
+		actor_timer_cancel(ticker);
+	}
+}
+
+static void once(void **stateptr, size_t nbytes, void *data)
+{
+	(void)stateptr; (void)nbytes; (void)data;
+
+	onces++;
+	once_ms = elapsed_ms();
+	ticks_at_once = ticks;
+
+	// Give a cancelled ticker time to misfire before dying.
+	send_message_after(actor_id_self(), (message_t){MSG_GODIE, 0, NULL}, 10000);
+}
+
+static void never(void **stateptr, size_t nbytes, void *data)
+{
+	(void)stateptr; (void)nbytes; (void)data;
+
+	nevers++;
+}
+
+static char *delayed_and_periodic()
+{
+	actor_id_t actor;
+	mu_assert("create failed", actor_system_create(&actor, &role) == 0);
+	actor_system_join(actor);
+
+	mu_assert("cancelled timer fired", nevers == 0);
+	mu_assert("cancelled twice", cancelled_twice == -1);
+	mu_assert("ticker cancelled early", ticks >= TICKS);
+	mu_assert("ticker not cancelled", ticks == ticks_at_once);
+	mu_assert("tick too early", first_tick_ms >= 5.0);
+	mu_assert("one-shot timer misfired", onces == 1);
+	mu_assert("one-shot timer too early", once_ms >= 50.0);
+	return 0;
+}
+
+static char *all_tests()
+{
+	mu_run_test(delayed_and_periodic);
+	return 0;
+}
+
+int main()
+{
+	char *result = all_tests();
+	if (result != 0)
+	{
+		printf(__FILE__ ": %s\n", result);
+	}
+	else
+	{
+		printf(__FILE__ ": ALL TESTS PASSED\n");
+	}
+	printf(__FILE__ ": Tests run: %d\n", tests_run);
+
+	return result != 0;
+}
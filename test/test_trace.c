@@ -0,0 +1,191 @@
+#include "minunit.h"
+#include "cacti.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define MSG_WORK 1
+#define SENT 100
+#define SAMPLE 4
+
+int tests_run = 0;
+
+static char trace_path[64];
+static char early_path[64];
+static int early_dump;
+static int untraced_dump;
+static long received;
+
+static void hello(void **stateptr, size_t nbytes, void *data);
+static void work(void **stateptr, size_t nbytes, void *data);
+
+static act_t acts[2] = {hello, work};
+static role_t role = {2, acts};
+
+static void hello(void **stateptr, size_t nbytes, void *data)
+{
+	(void)stateptr; (void)nbytes; (void)data;
+
+	actor_id_t self = actor_id_self();
+	actor_mailbox_configure(self, MAILBOX_GROW, 0);
+	for (int i = 0; i < SENT; i++) {
+		send_message(self, (message_t){MSG_WORK, 0, NULL});
+	}
+	early_dump = actor_system_trace_dump(actor_system_self(), early_path);
+}
+
+static void work(void **stateptr, size_t nbytes, void *data)
+{
+	(void)stateptr; (void)nbytes; (void)data;
+
+	if (++received == SENT) {
+		send_message(actor_id_self(), (message_t){MSG_GODIE, 0, NULL});
+	}
+}
+
+static void untraced_hello(void **stateptr, size_t nbytes, void *data)
+{
+	(void)stateptr; (void)nbytes; (void)data;
+
+	untraced_dump = actor_system_trace_dump(actor_system_self(), early_path);
+	send_message(actor_id_self(), (message_t){MSG_GODIE, 0, NULL});
+}
+
+static act_t untraced_acts[1] = {untraced_hello};
+static role_t untraced_role = {1, untraced_acts};
+
+static char *read_file(const char *path)
+{
+	FILE *file = fopen(path, "r");
+	if (file == NULL) {
+		return NULL;
+	}
+	fseek(file, 0, SEEK_END);
+	long size = ftell(file);
+	fseek(file, 0, SEEK_SET);
+
+	char *text = calloc(size + 1, 1);
+	if (text != NULL && fread(text, 1, size, file) != (size_t)size) {
+		free(text);
+		text = NULL;
+	}
+	fclose(file);
+
+	return text;
+}
+
+static long count(const char *text, const char *needle)
+{
+	long found = 0;
+	for (const char *at = strstr(text, needle); at != NULL; at = strstr(at + 1, needle)) {
+		found++;
+	}
+	return found;
+}
+
+static char *chrome_trace()
+{
+	snprintf(trace_path, sizeof(trace_path), "/tmp/cacti_trace_%d.json", getpid());
+	snprintf(early_path, sizeof(early_path), "/tmp/cacti_trace_%d_early.json", getpid());
+
+	actor_system_config_t config = {0};
+	config.pool_size = 2;
+	config.trace_path = trace_path;
+	config.trace_sample = 1;
+
+	actor_id_t actor;
+	mu_assert("create failed", actor_system_create_ex(&actor, &role, &config) == 0);
+	actor_system_join(actor);
+
+	char *trace = read_file(trace_path);
+	char *early = read_file(early_path);
+	unlink(trace_path);
+	unlink(early_path);
+
+	mu_assert("dump while running failed", early_dump == 0 && early != NULL);
+	mu_assert("trace not written", trace != NULL);
+	mu_assert("not a trace event file", strncmp(trace, "{\"traceEvents\":[", 16) == 0);
+
+	// The hello, SENT messages and MSG_GODIE, each sent and then handled.
+	long sends = count(trace, "\"ph\":\"s\"");
+	long prompts = count(trace, "\"ph\":\"X\"");
+	long flows = count(trace, "\"ph\":\"f\"");
+	long early_sends = count(early, "\"ph\":\"s\"");
+	free(trace);
+	free(early);
+
+	mu_assert("wrong number of sends", sends == SENT + 2);
+	mu_assert("wrong number of prompts", prompts == SENT + 2);
+	mu_assert("flows left open", flows == prompts);
+	mu_assert("early dump missed the sends so far", early_sends == SENT + 1);
+	return 0;
+}
+
+// Each thread traces its first send and then one in SAMPLE: the hello from
+// here, 1 + (SENT - 1) / SAMPLE of the prompt's sends and maybe MSG_GODIE.
+static char *sampled_trace()
+{
+	received = 0;
+
+	actor_system_config_t config = {0};
+	config.pool_size = 2;
+	config.trace_path = trace_path;
+	config.trace_sample = SAMPLE;
+
+	actor_id_t actor;
+	mu_assert("create failed", actor_system_create_ex(&actor, &role, &config) == 0);
+	actor_system_join(actor);
+
+	char *trace = read_file(trace_path);
+	unlink(trace_path);
+	unlink(early_path);
+	mu_assert("trace not written", trace != NULL);
+
+	long sends = count(trace, "\"ph\":\"s\"");
+	long prompts = count(trace, "\"ph\":\"X\"");
+	long flows = count(trace, "\"ph\":\"f\"");
+	free(trace);
+
+	long sampled = 2 + (SENT - 1) / SAMPLE;
+	mu_assert("wrong number of sends", sends == sampled || sends == sampled + 1);
+	mu_assert("wrong number of prompts", prompts == SENT + 2);
+	mu_assert("flows left open", flows == sends);
+	return 0;
+}
+
+static char *untraced()
+{
+	actor_id_t actor;
+	mu_assert("create failed", actor_system_create(&actor, &untraced_role) == 0);
+	actor_system_join(actor);
+
+	mu_assert("untraced system dumped a trace", untraced_dump == -1);
+	mu_assert("untraced system wrote a file", access(early_path, F_OK) != 0);
+	return 0;
+}
+
+static char *all_tests()
+{
+	mu_run_test(chrome_trace);
+	mu_run_test(sampled_trace);
+	mu_run_test(untraced);
+	return 0;
+}
+
+int main()
+{
+	char *result = all_tests();
+	if (result != 0)
+	{
+		printf(__FILE__ ": %s\n", result);
+	}
+	else
+	{
+		printf(__FILE__ ": ALL TESTS PASSED\n");
+	}
+	printf(__FILE__ ": Tests run: %d\n", tests_run);
+
+	return result != 0;
+}
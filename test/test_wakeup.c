@@ -0,0 +1,176 @@
+#include "minunit.h"
+#include "cacti.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#define MSG_COUNT 1
+#define WORKERS 4
+#define ROUNDS 20
+#define SENDERS 4
+#define SENDS 2000
+
+int tests_run = 0;
+
+static atomic_long handled;
+static actor_system_t *system;
+static actor_id_t root;
+
+static void counter_hello(void **stateptr, size_t nbytes, void *data);
+static void counter_count(void **stateptr, size_t nbytes, void *data);
+
+static act_t counter_acts[2] = {counter_hello, counter_count};
+static role_t counter_role = {2, counter_acts};
+
+static void counter_hello(void **stateptr, size_t nbytes, void *data)
+{
+	(void)stateptr; (void)nbytes; (void)data;
+
+	actor_mailbox_configure(actor_id_self(), MAILBOX_GROW, 0);
+}
+
+static void counter_count(void **stateptr, size_t nbytes, void *data)
+{
+	(void)stateptr; (void)nbytes; (void)data;
+
+	atomic_fetch_add(&handled, 1);
+}
+
+// Returns false when a worker has not parked yet.
+static bool parks_of(uint64_t *parks)
+{
+	actor_stats_t stats;
+	if (actor_system_stats(system, &stats) != 0) {
+		return false;
+	}
+
+	bool all_parked = true;
+	for (size_t i = 0; i < stats.worker_count; i++) {
+		parks[i] = stats.workers[i].parks;
+		all_parked = all_parked && parks[i] > 0;
+	}
+	actor_stats_free(&stats);
+
+	return all_parked;
+}
+
+static bool wait_handled(long count)
+{
+	for (int i = 0; i < 500 && atomic_load(&handled) < count; i++) {
+		usleep(1000);
+	}
+
+	return atomic_load(&handled) == count;
+}
+
+// A worker parks once more after every wakeup that finds nothing left, so
+// each send to an idle system adds exactly one park, by the worker it woke.
+static char *one_send_one_wakeup()
+{
+	actor_system_config_t config = {0};
+	config.pool_size = WORKERS;
+
+	mu_assert("start failed", actor_system_start(&system, &root, &counter_role, &config) == 0);
+
+	uint64_t before[WORKERS];
+	for (int i = 0; i < 500 && !parks_of(before); i++) {
+		usleep(1000);
+	}
+	usleep(20000);
+	mu_assert("workers never parked", parks_of(before));
+
+	uint64_t woken = 0;
+	for (int round = 1; round <= ROUNDS; round++) {
+		mu_assert("send failed", actor_system_send(system, root, (message_t){MSG_COUNT, 0, NULL}) == 0);
+		mu_assert("wakeup lost", wait_handled(round));
+		usleep(5000);
+
+		uint64_t after[WORKERS];
+		parks_of(after);
+		for (int i = 0; i < WORKERS; i++) {
+			woken += after[i] - before[i];
+			before[i] = after[i];
+		}
+	}
+
+	actor_system_send(system, root, (message_t){MSG_GODIE, 0, NULL});
+	actor_system_wait(system, root);
+
+	mu_assert("more than one worker woken per send", woken == ROUNDS);
+	return 0;
+}
+
+static void *sender_run(void *arg)
+{
+	(void)arg;
+
+	for (int i = 0; i < SENDS; i++) {
+		actor_system_send(system, root, (message_t){MSG_COUNT, 0, NULL});
+		if (i % 16 == 0) {
+			usleep(50);
+		}
+	}
+
+	return NULL;
+}
+
+// Senders keep racing workers that are about to park. A wakeup lost on the
+// way leaves messages behind with every worker asleep; a single worker has
+// no other to pick them up later.
+static char *race_senders(size_t pool_size)
+{
+	atomic_store(&handled, 0);
+
+	actor_system_config_t config = {0};
+	config.pool_size = pool_size;
+
+	mu_assert("start failed", actor_system_start(&system, &root, &counter_role, &config) == 0);
+	usleep(10000);
+
+	pthread_t senders[SENDERS];
+	for (int i = 0; i < SENDERS; i++) {
+		mu_assert("no thread", pthread_create(&senders[i], NULL, sender_run, NULL) == 0);
+	}
+	for (int i = 0; i < SENDERS; i++) {
+		pthread_join(senders[i], NULL);
+	}
+
+	bool drained = wait_handled(SENDERS * SENDS);
+	actor_system_send(system, root, (message_t){MSG_GODIE, 0, NULL});
+	actor_system_wait(system, root);
+
+	mu_assert("messages left behind", drained);
+	return 0;
+}
+
+static char *racing_senders()
+{
+	char *result = race_senders(1);
+	return result != 0 ? result : race_senders(WORKERS);
+}
+
+static char *all_tests()
+{
+	mu_run_test(one_send_one_wakeup);
+	mu_run_test(racing_senders);
+	return 0;
+}
+
+int main()
+{
+	char *result = all_tests();
+	if (result != 0)
+	{
+		printf(__FILE__ ": %s\n", result);
+	}
+	else
+	{
+		printf(__FILE__ ": ALL TESTS PASSED\n");
+	}
+	printf(__FILE__ ": Tests run: %d\n", tests_run);
+
+	return result != 0;
+}